@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace GTOML {
+namespace bench {
+
+// Heap allocations made by the benchmark process so far. The counters are
+// maintained by the replacement operator new in main.cpp.
+struct Allocations {
+  uint64_t count;
+  uint64_t bytes;
+};
+Allocations allocations();
+
+class Timer {
+ public:
+  Timer() : start(std::chrono::steady_clock::now()) {}
+  double seconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start;
+};
+
+// A synthetic configuration of roughly `bytes` bytes made of tables with
+// scalar keys and string arrays.
+std::string generateConfig(size_t bytes);
+// Long string arrays interleaved with comment blocks.
+std::string generateStringsAndComments(size_t bytes);
+// Tables of integers, floats, hex masks and numeric arrays.
+std::string generateNumbers(size_t bytes);
+// A few tables with thousands of keys each.
+std::string generateWideTables(size_t bytes);
+// Tables named by long dotted paths, holding dotted keys.
+std::string generateDeepKeys(size_t bytes);
+// A handful of keys whose arrays hold most of the bytes, some nested.
+std::string generateHugeArrays(size_t bytes);
+// Strings of several KiB each.
+std::string generateLongStrings(size_t bytes);
+// Mostly comment lines, with a few keys between them.
+std::string generateComments(size_t bytes);
+
+// A generated input by name ("config", "wide", "deep", "arrays",
+// "strings", "comments", "numbers"), or "" for an unknown name.
+std::string generateCorpus(const std::string& kind, size_t bytes);
+
+}  // namespace bench
+}  // namespace GTOML
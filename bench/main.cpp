@@ -0,0 +1,1194 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "../src/batch.hpp"
+#include "../src/bind.hpp"
+#include "../src/emit.hpp"
+#include "../src/events.hpp"
+#include "../src/lazy.hpp"
+#include "../src/lexer.hpp"
+#include "../src/parser.hpp"
+#include "../src/reload.hpp"
+#include "../src/scanner.hpp"
+#include "../src/snapshot.hpp"
+#include "bench.hpp"
+
+using namespace GTOML;
+
+static std::atomic<uint64_t> allocationCount{0};
+static std::atomic<uint64_t> allocationBytes{0};
+
+// Every form of operator new and delete goes through these two, so all of
+// them are counted and each pointer is freed the way it was allocated. They
+// are kept out of line so the compiler never pairs an inlined free() with a
+// call to operator new and warns about a mismatch.
+namespace {
+[[gnu::noinline]] void* allocate(size_t size, size_t alignment) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  allocationBytes.fetch_add(size, std::memory_order_relaxed);
+  size = size ? size : 1;
+  if (alignment <= alignof(std::max_align_t)) {
+    return std::malloc(size);
+  }
+  // aligned_alloc() wants a multiple of the alignment.
+  size = (size + alignment - 1) & ~(alignment - 1);
+  return std::aligned_alloc(alignment, size);
+}
+
+void* allocateOrThrow(size_t size, size_t alignment) {
+  if (void* p = allocate(size, alignment)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void release(void* p) noexcept { std::free(p); }
+}  // namespace
+
+void* operator new(size_t size) {
+  return allocateOrThrow(size, alignof(std::max_align_t));
+}
+void* operator new[](size_t size) {
+  return allocateOrThrow(size, alignof(std::max_align_t));
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+  return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size, alignof(std::max_align_t));
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size, alignof(std::max_align_t));
+}
+void* operator new(size_t size, std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept {
+  return allocate(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+  return allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  release(p);
+}
+void operator delete(void* p, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+  release(p);
+}
+void operator delete[](void* p, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+  release(p);
+}
+
+bench::Allocations bench::allocations() {
+  return {allocationCount.load(), allocationBytes.load()};
+}
+
+std::string bench::generateConfig(size_t bytes) {
+  std::string out;
+  out.reserve(bytes + 256);
+  for (size_t table = 0; out.size() < bytes; ++table) {
+    out += "[table_" + std::to_string(table) + "]\n";
+    out += "name = \"service-" + std::to_string(table) + "\"\n";
+    out += "port = " + std::to_string(8000 + table % 1000) + "\n";
+    out += "ratio = 0." + std::to_string(table % 10) + "\n";
+    out += "enabled = true\n";
+    out += "hosts = [\n";
+    for (int host = 0; host < 4; ++host) {
+      out += "    \"host-" + std::to_string(host) + ".example.com\",\n";
+    }
+    out += "]\n";
+  }
+  return out;
+}
+
+std::string bench::generateStringsAndComments(size_t bytes) {
+  std::string out;
+  out.reserve(bytes + 512);
+  for (size_t table = 0; out.size() < bytes; ++table) {
+    out += "# Routes for shard " + std::to_string(table) +
+           ". Generated file, do not edit by hand; every entry below is an\n"
+           "# upstream path that the edge proxy forwards without rewriting.\n";
+    out += "[shard_" + std::to_string(table) + "]\n";
+    out += "routes = [\n";
+    for (int route = 0; route < 8; ++route) {
+      out += "    \"/api/v2/accounts/{account_id}/projects/{project_id}/"
+             "resources/" +
+             std::to_string(route) + "/history?expand=owner,labels\",\n";
+    }
+    out += "]\n";
+  }
+  return out;
+}
+
+std::string bench::generateNumbers(size_t bytes) {
+  std::string out;
+  out.reserve(bytes + 512);
+  for (size_t table = 0; out.size() < bytes; ++table) {
+    std::string n = std::to_string(table);
+    out += "[metrics_" + n + "]\n";
+    out += "count = " + std::to_string(table * 7919 % 1000003) + "\n";
+    out += "offset = -" + std::to_string(table % 977) + "\n";
+    out += "ratio = 0." + std::to_string(123456789 + table) + "\n";
+    out += "scale = 6.02e" + std::to_string(table % 30) + "\n";
+    out += "mask = 0xdead_beef\n";
+    out += "big = 1_000_" + std::to_string(100 + table % 900) + "\n";
+    out += "samples = [1.5, 2.25, -3.125, 4.0, 5.5, 6.75, 7.0, 8.5]\n";
+    out += "ids = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12]\n";
+  }
+  return out;
+}
+
+std::string bench::generateWideTables(size_t bytes) {
+  std::string out;
+  out.reserve(bytes + 256);
+  for (size_t table = 0; out.size() < bytes; ++table) {
+    out += "[wide_" + std::to_string(table) + "]\n";
+    for (size_t key = 0; key < 5000 && out.size() < bytes; ++key) {
+      out += "key_" + std::to_string(key) + " = " +
+             std::to_string(key * 2654435761u % 100000) + "\n";
+    }
+  }
+  return out;
+}
+
+std::string bench::generateDeepKeys(size_t bytes) {
+  std::string out;
+  out.reserve(bytes + 256);
+  for (size_t table = 0; out.size() < bytes; ++table) {
+    std::string n = std::to_string(table);
+    out += "[region.zone_" + std::to_string(table % 8) +
+           ".cluster.node_pool.node_" + n + ".runtime.limits]\n";
+    out += "cpu.cores.max = " + std::to_string(table % 64 + 1) + "\n";
+    out += "memory.bytes.soft.limit = " + std::to_string(table << 20) + "\n";
+    out += "network.egress.rate.per_second = 1.5e9\n";
+    out += "scheduling.priority.class.name = \"batch-" + n + "\"\n";
+  }
+  return out;
+}
+
+std::string bench::generateHugeArrays(size_t bytes) {
+  std::string out;
+  out.reserve(bytes + 256);
+  size_t quarter = bytes / 4;
+  out += "integers = [";
+  for (size_t i = 0; out.size() < quarter; ++i) {
+    out += std::to_string(i * 7919 % 1000003) + ", ";
+  }
+  out += "]\nfloats = [";
+  for (size_t i = 0; out.size() < 2 * quarter; ++i) {
+    out += std::to_string(i % 1000) + ".25, ";
+  }
+  out += "]\nnames = [";
+  for (size_t i = 0; out.size() < 3 * quarter; ++i) {
+    out += "\"item-" + std::to_string(i) + "\", ";
+  }
+  out += "]\npairs = [";
+  for (size_t i = 0; out.size() < bytes; ++i) {
+    out += "[" + std::to_string(i) + ", \"v" + std::to_string(i) + "\"], ";
+  }
+  out += "]\n";
+  return out;
+}
+
+std::string bench::generateLongStrings(size_t bytes) {
+  std::string out;
+  out.reserve(bytes + 64 * 1024);
+  std::string words =
+      "lorem ipsum dolor sit amet consectetur adipiscing elit sed do ";
+  for (size_t table = 0; out.size() < bytes; ++table) {
+    out += "[document_" + std::to_string(table) + "]\n";
+    out += "body = \"";
+    size_t length = 4096 << (table % 4);
+    for (size_t written = 0; written < length; written += words.size()) {
+      out += words;
+    }
+    out += "\"\n";
+  }
+  return out;
+}
+
+std::string bench::generateComments(size_t bytes) {
+  std::string out;
+  out.reserve(bytes + 512);
+  for (size_t table = 0; out.size() < bytes; ++table) {
+    for (int line = 0; line < 12; ++line) {
+      out += "# Line " + std::to_string(line) +
+             " of the notes for this section: values = [1, 2], \"quoted\" "
+             "and [brackets] inside comments are not syntax.\n";
+    }
+    out += "[section_" + std::to_string(table) + "]\n";
+    out += "enabled = true  # trailing comment\n";
+  }
+  return out;
+}
+
+std::string bench::generateCorpus(const std::string& kind, size_t bytes) {
+  if (kind == "config") {
+    return generateConfig(bytes);
+  } else if (kind == "wide") {
+    return generateWideTables(bytes);
+  } else if (kind == "deep") {
+    return generateDeepKeys(bytes);
+  } else if (kind == "arrays") {
+    return generateHugeArrays(bytes);
+  } else if (kind == "strings") {
+    return generateLongStrings(bytes);
+  } else if (kind == "comments") {
+    return generateComments(bytes);
+  } else if (kind == "numbers") {
+    return generateNumbers(bytes);
+  }
+  return "";
+}
+
+// Lexes the input once per available scanner backend.
+static void benchLex(const char* name, const std::string& input) {
+  auto source = Source::borrow(input);
+  double mb = input.size() / (1024.0 * 1024.0);
+  std::printf("lex %s: %zu bytes\n", name, input.size());
+
+  simd::Backend best = simd::bestBackend();
+  for (int b = 0; b <= static_cast<int>(best); ++b) {
+    simd::setBackend(static_cast<simd::Backend>(b));
+    double fastest = 1e30;
+    for (int run = 0; run < 3; ++run) {
+      Lexer lexer(source);
+      bench::Timer timer;
+      lexer.lex();
+      fastest = std::min(fastest, timer.seconds());
+    }
+    std::printf("  %-12s  %8.1f MB/s\n",
+                simd::backendName(simd::activeBackend()), mb / fastest);
+  }
+  simd::setBackend(best);
+}
+
+// Lexes the input and then walks every token through the same accessors
+// the parser uses, reporting heap allocations per token for each step.
+static void benchTokens(const std::string& input) {
+  auto source = Source::borrow(input);
+
+  bench::Allocations before = bench::allocations();
+  bench::Timer lexTimer;
+  Lexer lexer(source);
+  lexer.lex();
+  double lexSeconds = lexTimer.seconds();
+  bench::Allocations afterLex = bench::allocations();
+
+  size_t tokens = lexer.tokenCount();
+  size_t checksum = 0;
+  bench::Timer walkTimer;
+  while (lexer.hasMoreTokens()) {
+    checksum += lexer.GetCurrentToken().value.size();
+    checksum += lexer.PrevToken().value.size();
+    checksum += lexer.PervPrevToken().value.size();
+    checksum += lexer.NextToken().value.size();
+  }
+  double walkSeconds = walkTimer.seconds();
+  bench::Allocations afterWalk = bench::allocations();
+
+  double mb = input.size() / (1024.0 * 1024.0);
+  std::printf("tokens: %zu bytes, %zu tokens (checksum %zu)\n", input.size(),
+              tokens, checksum);
+  std::printf("  lex           %8.1f MB/s  %.4f allocations/token\n",
+              mb / lexSeconds,
+              double(afterLex.count - before.count) / tokens);
+  std::printf("  token peeks   %8.1f MB/s  %.4f allocations/token\n",
+              mb / walkSeconds,
+              double(afterWalk.count - afterLex.count) / tokens);
+  std::printf("  materialized  %8.1f MiB of token storage\n",
+              (afterLex.bytes - before.bytes) / (1024.0 * 1024.0));
+
+  // The same walk on a streaming lexer, which is what the parser uses.
+  before = bench::allocations();
+  bench::Timer streamTimer;
+  Lexer stream(source);
+  while (stream.hasMoreTokens()) {
+    checksum += stream.GetCurrentToken().value.size();
+    checksum += stream.PrevToken().value.size();
+    checksum += stream.PervPrevToken().value.size();
+    checksum += stream.NextToken().value.size();
+  }
+  double streamSeconds = streamTimer.seconds();
+  bench::Allocations afterStream = bench::allocations();
+  std::printf("  streaming     %8.1f MB/s  %.4f MiB of token storage\n",
+              mb / streamSeconds,
+              (afterStream.bytes - before.bytes) / (1024.0 * 1024.0));
+}
+
+// Parses the input into a document and then destroys it.
+static void benchParse(const char* name, const std::string& input) {
+  auto source = Source::borrow(input);
+  double mb = input.size() / (1024.0 * 1024.0);
+
+  bench::Allocations before = bench::allocations();
+  bench::Timer parseTimer;
+  auto parser = std::make_unique<Parser>(source);
+  double parseSeconds = parseTimer.seconds();
+  bench::Allocations afterParse = bench::allocations();
+
+  bench::Timer destroyTimer;
+  parser.reset();
+  double destroySeconds = destroyTimer.seconds();
+
+  std::printf("parse %s: %zu bytes\n", name, input.size());
+  std::printf("  parse         %8.1f MB/s  %llu allocations, %.1f MiB\n",
+              mb / parseSeconds,
+              (unsigned long long)(afterParse.count - before.count),
+              (afterParse.bytes - before.bytes) / (1024.0 * 1024.0));
+  std::printf("  destroy       %8.2f ms\n", destroySeconds * 1000);
+}
+
+// Parse throughput of the parallel mode for 1, 2, 4, ... threads up to the
+// number of hardware threads.
+static void benchParallel(const char* name, const std::string& input) {
+  auto source = Source::borrow(input);
+  double mb = input.size() / (1024.0 * 1024.0);
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  std::printf("parallel parse %s: %zu bytes, %u hardware threads\n", name,
+              input.size(), cores);
+
+  double base = 0;
+  for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+    double fastest = 1e30;
+    for (int run = 0; run < 3; ++run) {
+      bench::Timer timer;
+      Parser parser(source, threads);
+      fastest = std::min(fastest, timer.seconds());
+    }
+    if (threads == 1) {
+      base = fastest;
+    }
+    std::printf("  %2u threads    %8.1f MB/s  %.2fx\n", threads, mb / fastest,
+                base / fastest);
+    if (threads == cores) {
+      break;
+    }
+  }
+}
+
+// Parses `files` small generated configs of about 2 KiB each and keeps every
+// document: one Parser per file on the calling thread versus a BatchLoader
+// on 1, 2, 4, ... hardware threads.
+static void benchBatch(size_t files) {
+  std::vector<std::string> inputs;
+  std::vector<std::string_view> views;
+  size_t total = 0;
+  for (size_t i = 0; i < files; ++i) {
+    inputs.push_back(bench::generateConfig(2048));
+    total += inputs.back().size();
+  }
+  for (const auto& input : inputs) {
+    views.push_back(input);
+  }
+  double mb = total / (1024.0 * 1024.0);
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  std::printf("batch: %zu files, %zu bytes, %u hardware threads\n", files,
+              total, cores);
+
+  bench::Allocations before = bench::allocations();
+  bench::Timer timer;
+  size_t parsed = 0;
+  std::vector<std::unique_ptr<Parser>> parsers;
+  for (const auto& view : views) {
+    parsers.push_back(std::make_unique<Parser>(Source::borrow(view)));
+    parsed += parsers.back()->getError().empty();
+  }
+  double seconds = timer.seconds();
+  bench::Allocations after = bench::allocations();
+  std::printf("  one by one    %8.1f MB/s  %.1f allocations/file\n",
+              mb / seconds, double(after.count - before.count) / files);
+
+  for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+    BatchLoader loader(threads);
+    before = bench::allocations();
+    timer = bench::Timer();
+    auto results = loader.loadBuffers(views);
+    seconds = timer.seconds();
+    after = bench::allocations();
+    for (const auto& result : results) {
+      parsed += result.ok();
+    }
+    std::printf("  %2u threads    %8.1f MB/s  %.1f allocations/file\n",
+                threads, mb / seconds,
+                double(after.count - before.count) / files);
+    if (threads == cores) {
+      break;
+    }
+  }
+  std::printf("  (%zu parsed)\n", parsed);
+}
+
+// Latency of changing one value in the middle of a generated config:
+// applyEdit() against a full reparse of the edited text.
+static void benchEdit(const std::string& input) {
+  std::string text = input;
+  size_t at = text.find("port = ", text.size() / 2) + 7;
+  Parser parser(Source::copy(text));
+  // The first edit also maps the sections of the document.
+  bench::Timer timer;
+  parser.applyEdit(Source::copy(text), at, 0, 0);
+  double setupSeconds = timer.seconds();
+
+  std::vector<std::shared_ptr<const Source>> edits;
+  for (int i = 0; i < 100; ++i) {
+    text[at] = '0' + i % 10;
+    edits.push_back(Source::copy(text));
+  }
+  timer = bench::Timer();
+  for (const auto& edit : edits) {
+    parser.applyEdit(edit, at, 1, 1);
+  }
+  double editSeconds = timer.seconds() / edits.size();
+
+  timer = bench::Timer();
+  parser.reparse(edits.back());
+  double reparseSeconds = timer.seconds();
+
+  std::printf("edit: one value in %zu bytes\n", input.size());
+  std::printf("  first edit    %8.3f ms\n", setupSeconds * 1000);
+  std::printf("  applyEdit     %8.3f ms\n", editSeconds * 1000);
+  std::printf("  reparse       %8.3f ms\n", reparseSeconds * 1000);
+}
+
+// Cost of pinning the current document of a ReloadableDocument for each
+// lookup, on every hardware thread at once.
+static void benchReload() {
+  const char* path = "gtoml_bench_reload.toml";
+  std::FILE* file = std::fopen(path, "wb");
+  std::fputs("[server]\nport = 8080\n", file);
+  std::fclose(file);
+
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  const int lookups = 1000000;
+  ReloadableDocument live(path);
+  std::atomic<uint64_t> checksum{0};
+  bench::Timer timer;
+  std::vector<std::thread> readers;
+  for (unsigned t = 0; t < cores; ++t) {
+    readers.emplace_back([&] {
+      uint64_t sum = 0;
+      for (int i = 0; i < lookups; ++i) {
+        sum += live.read()->get<int64_t>("server.port").value_or(0);
+      }
+      checksum += sum;
+    });
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  double seconds = timer.seconds();
+  std::printf("reload: %u reader threads (checksum %llu)\n", cores,
+              (unsigned long long)checksum.load());
+  std::printf("  read+get      %8.1f ns/lookup per thread\n",
+              seconds * 1e9 / lookups);
+
+  auto pinned = live.read();
+  uint64_t sum = 0;
+  timer = bench::Timer();
+  for (int i = 0; i < lookups; ++i) {
+    sum += pinned->get<int64_t>("server.port").value_or(0);
+  }
+  seconds = timer.seconds();
+  std::printf("  get (pinned)  %8.1f ns/lookup (checksum %llu)\n",
+              seconds * 1e9 / lookups, (unsigned long long)sum);
+  std::remove(path);
+}
+
+// Cold start from text versus from a snapshot: the time until the first
+// lookup can be answered. Both files are read from the page cache.
+static void benchSnapshot(const std::string& input) {
+  const char* text = "gtoml_bench.toml";
+  const char* cache = "gtoml_bench.snapshot";
+  std::FILE* file = std::fopen(text, "wb");
+  std::fwrite(input.data(), 1, input.size(), file);
+  std::fclose(file);
+  std::remove(cache);
+
+  double mb = input.size() / (1024.0 * 1024.0);
+  bench::Timer timer;
+  auto built = Snapshot::load(text, cache);
+  double buildSeconds = timer.seconds();
+
+  double parseSeconds = 1e30;
+  double contentSeconds = 1e30;
+  double mtimeSeconds = 1e30;
+  size_t checksum = 0;
+  for (int run = 0; run < 3; ++run) {
+    timer = bench::Timer();
+    Parser parser(text, Input::Map);
+    checksum += parser.get<int64_t>("table_0.port").value_or(0);
+    parseSeconds = std::min(parseSeconds, timer.seconds());
+
+    timer = bench::Timer();
+    auto byContent = Snapshot::load(text, cache, Validate::Content);
+    checksum += byContent->get<int64_t>("table_0.port").value_or(0);
+    contentSeconds = std::min(contentSeconds, timer.seconds());
+
+    timer = bench::Timer();
+    auto byMtime = Snapshot::load(text, cache, Validate::Mtime);
+    checksum += byMtime->get<int64_t>("table_0.port").value_or(0);
+    mtimeSeconds = std::min(mtimeSeconds, timer.seconds());
+  }
+
+  std::printf("snapshot: %zu bytes, %.1f MiB cache (checksum %zu)\n",
+              input.size(), built->bytes() / (1024.0 * 1024.0), checksum);
+  std::printf("  build         %8.2f ms\n", buildSeconds * 1000);
+  std::printf("  text parse    %8.2f ms  %8.1f MB/s\n", parseSeconds * 1000,
+              mb / parseSeconds);
+  std::printf("  by content    %8.2f ms  %8.1f MB/s\n", contentSeconds * 1000,
+              mb / contentSeconds);
+  std::printf("  by mtime      %8.2f ms  %8.1f MB/s\n", mtimeSeconds * 1000,
+              mb / mtimeSeconds);
+  std::remove(text);
+  std::remove(cache);
+}
+
+struct BenchServer {
+  std::string host;
+  uint16_t port = 0;
+  int64_t workers = 0;
+  double timeout = 0;
+  bool tls = false;
+};
+
+struct BenchDatabase {
+  std::string url;
+  int64_t pool = 0;
+  std::vector<std::string> replicas;
+};
+
+struct BenchService {
+  std::string name;
+  BenchServer server;
+  BenchDatabase database;
+  std::vector<std::string> routes;
+};
+
+namespace GTOML {
+template <>
+struct Binding<BenchServer> {
+  static void describe(Fields<BenchServer>& fields) {
+    fields.required("host", &BenchServer::host)
+        .required("port", &BenchServer::port)
+        .required("workers", &BenchServer::workers)
+        .required("timeout", &BenchServer::timeout)
+        .required("tls", &BenchServer::tls);
+  }
+};
+template <>
+struct Binding<BenchDatabase> {
+  static void describe(Fields<BenchDatabase>& fields) {
+    fields.required("url", &BenchDatabase::url)
+        .required("pool", &BenchDatabase::pool)
+        .required("replicas", &BenchDatabase::replicas);
+  }
+};
+template <>
+struct Binding<BenchService> {
+  static void describe(Fields<BenchService>& fields) {
+    fields.required("name", &BenchService::name)
+        .required("server", &BenchService::server)
+        .required("database", &BenchService::database)
+        .required("routes", &BenchService::routes);
+  }
+};
+}  // namespace GTOML
+
+// A service reading its config into its own structs: parsing and copying
+// each field out of the document, against binding the fields directly.
+static void benchBind() {
+  std::string input = "name = \"edge-proxy\"\nroutes = [\n";
+  for (int route = 0; route < 24; ++route) {
+    input += "    \"/api/v2/resources/" + std::to_string(route) + "\",\n";
+  }
+  input +=
+      "]\n"
+      "[server]\nhost = \"0.0.0.0\"\nport = 8443\nworkers = 16\n"
+      "timeout = 2.5\ntls = true\n"
+      "[database]\nurl = \"postgres://db.internal:5432/edge\"\npool = 32\n"
+      "replicas = [\"db-1.internal\", \"db-2.internal\", "
+      "\"db-3.internal\"]\n";
+
+  const int rounds = 20000;
+  size_t checksum = 0;
+  bench::Allocations before = bench::allocations();
+  bench::Timer timer;
+  for (int round = 0; round < rounds; ++round) {
+    Parser parser(Source::borrow(input));
+    BenchService service;
+    service.name = parser.get<std::string_view>("name").value_or("");
+    service.server.host =
+        parser.get<std::string_view>("server.host").value_or("");
+    service.server.port =
+        static_cast<uint16_t>(parser.get<int64_t>("server.port").value_or(0));
+    service.server.workers = parser.get<int64_t>("server.workers").value_or(0);
+    service.server.timeout = parser.get<double>("server.timeout").value_or(0);
+    service.server.tls = parser.get<bool>("server.tls").value_or(false);
+    service.database.url =
+        parser.get<std::string_view>("database.url").value_or("");
+    service.database.pool = parser.get<int64_t>("database.pool").value_or(0);
+    for (const Value& replica :
+         parser.get<ArrayView>("database.replicas").value_or(ArrayView())) {
+      service.database.replicas.emplace_back(replica.asString());
+    }
+    for (const Value& route :
+         parser.get<ArrayView>("routes").value_or(ArrayView())) {
+      service.routes.emplace_back(route.asString());
+    }
+    checksum += service.server.port + service.routes.size();
+  }
+  double parseSeconds = timer.seconds() / rounds;
+  bench::Allocations parseAllocations = bench::allocations();
+  parseAllocations.count -= before.count;
+
+  before = bench::allocations();
+  timer = bench::Timer();
+  for (int round = 0; round < rounds; ++round) {
+    BenchService service;
+    if (!bind(Source::borrow(input), service)) {
+      std::printf("bind failed\n");
+      return;
+    }
+    checksum += service.server.port + service.routes.size();
+  }
+  double bindSeconds = timer.seconds() / rounds;
+  bench::Allocations bindAllocations = bench::allocations();
+  bindAllocations.count -= before.count;
+
+  std::printf("bind: %zu byte config, %d rounds (checksum %zu)\n",
+              input.size(), rounds, checksum);
+  std::printf("  parse+copy    %8.2f us/config  %.1f allocations/config\n",
+              parseSeconds * 1e6, double(parseAllocations.count) / rounds);
+  std::printf("  bind          %8.2f us/config  %.1f allocations/config\n",
+              bindSeconds * 1e6, double(bindAllocations.count) / rounds);
+}
+
+// Counts the keys and values of a document, as an indexer would.
+struct CountingHandler : Handler {
+  size_t tables = 0;
+  size_t keys = 0;
+  size_t values = 0;
+
+  bool onTableBegin(std::string_view) override {
+    ++tables;
+    return true;
+  }
+  bool onKey(std::string_view) override {
+    ++keys;
+    return true;
+  }
+  bool onScalar(const Value&) override {
+    ++values;
+    return true;
+  }
+};
+
+// Streaming over a document through the event interface, against building
+// the document.
+static void benchEvents(const std::string& input) {
+  double mb = input.size() / (1024.0 * 1024.0);
+  double parseSeconds = 1e30;
+  double eventSeconds = 1e30;
+  bench::Allocations parseAllocations{};
+  bench::Allocations eventAllocations{};
+  CountingHandler counts;
+  for (int run = 0; run < 3; ++run) {
+    bench::Allocations before = bench::allocations();
+    bench::Timer timer;
+    {
+      Parser parser(Source::borrow(input));
+    }
+    parseSeconds = std::min(parseSeconds, timer.seconds());
+    parseAllocations = bench::allocations();
+    parseAllocations.count -= before.count;
+    parseAllocations.bytes -= before.bytes;
+
+    counts = CountingHandler();
+    before = bench::allocations();
+    timer = bench::Timer();
+    parseEvents(Source::borrow(input), counts);
+    eventSeconds = std::min(eventSeconds, timer.seconds());
+    eventAllocations = bench::allocations();
+    eventAllocations.count -= before.count;
+    eventAllocations.bytes -= before.bytes;
+  }
+
+  std::printf("events: %zu bytes, %zu tables, %zu keys, %zu values\n",
+              input.size(), counts.tables, counts.keys, counts.values);
+  std::printf("  document      %8.1f MB/s  %llu allocations, %.1f MiB\n",
+              mb / parseSeconds, (unsigned long long)parseAllocations.count,
+              parseAllocations.bytes / (1024.0 * 1024.0));
+  std::printf("  events        %8.1f MB/s  %llu allocations, %.1f MiB\n",
+              mb / eventSeconds, (unsigned long long)eventAllocations.count,
+              eventAllocations.bytes / (1024.0 * 1024.0));
+}
+
+// Writing TOML: a parsed document back out, and a routes file generated
+// call by call into a reused buffer.
+static void benchEmit(const std::string& input) {
+  Parser parser(Source::borrow(input));
+  Emitter out;
+  double documentSeconds = 1e30;
+  for (int run = 0; run < 3; ++run) {
+    out.clear();
+    bench::Timer timer;
+    out.document(parser.getDocument());
+    documentSeconds = std::min(documentSeconds, timer.seconds());
+  }
+  size_t documentBytes = out.view().size();
+
+  const size_t routes = 200000;
+  double builderSeconds = 1e30;
+  bench::Allocations builderAllocations{};
+  for (int run = 0; run < 3; ++run) {
+    out.clear();
+    bench::Allocations before = bench::allocations();
+    bench::Timer timer;
+    for (size_t route = 0; route < routes; ++route) {
+      char name[32];
+      std::snprintf(name, sizeof(name), "route_%zu", route);
+      out.table(name)
+          .key("path")
+          .string("/api/v2/accounts/{id}/resources")
+          .key("weight")
+          .integer(route % 100)
+          .key("timeout")
+          .floating(0.25 * (route % 8))
+          .key("upstreams")
+          .beginArray()
+          .string("10.0.0.1:8080")
+          .string("10.0.0.2:8080")
+          .endArray();
+    }
+    builderSeconds = std::min(builderSeconds, timer.seconds());
+    builderAllocations = bench::allocations();
+    builderAllocations.count -= before.count;
+  }
+  size_t builderBytes = out.view().size();
+
+  std::printf("emit: %zu byte document, %zu routes (%s)\n", documentBytes,
+              routes, out.ok() ? "ok" : out.getError().c_str());
+  std::printf("  document      %8.1f MB/s\n",
+              documentBytes / (1024.0 * 1024.0) / documentSeconds);
+  std::printf("  builder       %8.1f MB/s  %llu allocations\n",
+              builderBytes / (1024.0 * 1024.0) / builderSeconds,
+              (unsigned long long)builderAllocations.count);
+}
+
+// A process that reads a few tables out of a large file: the lazy document
+// scans the headers and parses only those tables.
+static void benchLazy(const std::string& input) {
+  const char* keys[] = {"table_0.port", "table_17.name", "table_4000.hosts",
+                        "table_100000.enabled"};
+  double mb = input.size() / (1024.0 * 1024.0);
+  double eagerSeconds = 1e30;
+  double openSeconds = 1e30;
+  double lookupSeconds = 1e30;
+  size_t checksum = 0;
+  size_t parsed = 0;
+  for (int run = 0; run < 3; ++run) {
+    bench::Timer timer;
+    Parser parser(Source::borrow(input));
+    for (const char* key : keys) {
+      checksum += parser.getDocument().find(key) != nullptr;
+    }
+    eagerSeconds = std::min(eagerSeconds, timer.seconds());
+
+    timer = bench::Timer();
+    LazyDocument lazy(Source::borrow(input));
+    openSeconds = std::min(openSeconds, timer.seconds());
+    timer = bench::Timer();
+    for (const char* key : keys) {
+      checksum += lazy.find(key) != nullptr;
+    }
+    lookupSeconds = std::min(lookupSeconds, timer.seconds());
+    parsed = lazy.parsedCount();
+  }
+
+  std::printf("lazy: %zu bytes, %zu lookups (checksum %zu)\n", input.size(),
+              sizeof(keys) / sizeof(keys[0]), checksum);
+  std::printf("  full parse    %8.2f ms  %8.1f MB/s\n", eagerSeconds * 1000,
+              mb / eagerSeconds);
+  std::printf("  header scan   %8.2f ms  %8.1f MB/s\n", openSeconds * 1000,
+              mb / openSeconds);
+  std::printf("  lookups       %8.2f ms  %zu tables parsed\n",
+              lookupSeconds * 1000, parsed);
+}
+
+// What recording phases costs: a parse without stats, with stats, and with
+// lexing timed apart, followed by the phases the last one recorded.
+static void benchStats(const std::string& input) {
+  double mb = input.size() / (1024.0 * 1024.0);
+  double plainSeconds = 1e30;
+  double statsSeconds = 1e30;
+  double splitSeconds = 1e30;
+  std::vector<PhaseStats> phases;
+  for (int run = 0; run < 3; ++run) {
+    bench::Timer timer;
+    {
+      Parser parser(Source::borrow(input));
+    }
+    plainSeconds = std::min(plainSeconds, timer.seconds());
+
+    Stats stats;
+    timer = bench::Timer();
+    {
+      Parser parser(Source::borrow(input), 1, &stats);
+    }
+    statsSeconds = std::min(statsSeconds, timer.seconds());
+
+    Stats split;
+    split.splitLexing = true;
+    timer = bench::Timer();
+    {
+      Parser parser(Source::borrow(input), 1, &split);
+    }
+    splitSeconds = std::min(splitSeconds, timer.seconds());
+    phases = split.phases();
+  }
+
+  std::printf("stats: %zu bytes\n", input.size());
+  std::printf("  no stats      %8.1f MB/s\n", mb / plainSeconds);
+  std::printf("  stats         %8.1f MB/s\n", mb / statsSeconds);
+  std::printf("  split lexing  %8.1f MB/s\n", mb / splitSeconds);
+  for (const auto& phase : phases) {
+    std::printf("    %-10s %8.2f ms  %llu tokens, %llu nodes, %.1f MiB\n",
+                phase.name, phase.durationNs / 1e6,
+                (unsigned long long)phase.tokens,
+                (unsigned long long)phase.nodes,
+                phase.bytes / (1024.0 * 1024.0));
+  }
+}
+
+// How much text the document keeps once interning has folded repeated keys
+// and strings. Without the pool the document pinned the whole source.
+static void benchMemory(const char* name, const std::string& input) {
+  Parser parser(Source::borrow(input));
+  const Document& document = parser.getDocument();
+  const InternPool& strings = document.strings;
+
+  std::printf("memory %s: %zu bytes\n", name, input.size());
+  std::printf("  strings       %zu interned, %zu distinct, %.2f MiB stored\n",
+              strings.requests(), strings.size(),
+              strings.bytes() / (1024.0 * 1024.0));
+  std::printf("  document      %.2f MiB arena vs %.2f MiB source text\n",
+              document.arena.bytesReserved() / (1024.0 * 1024.0),
+              input.size() / (1024.0 * 1024.0));
+}
+
+// Looks up keys spread over every table of a generated config.
+static void benchLookup(const std::string& input) {
+  Parser parser(Source::borrow(input));
+  size_t tables = 0;
+  for (size_t at = 0; (at = input.find("[table_", at)) != std::string::npos;
+       ++at) {
+    ++tables;
+  }
+
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < 1000; ++i) {
+    keys.push_back("table_" + std::to_string(i * 7919 % tables) + ".port");
+  }
+
+  size_t checksum = 0;
+  bench::Allocations before = bench::allocations();
+  bench::Timer timer;
+  for (const auto& key : keys) {
+    checksum += parser.getTableValue(key).size();
+  }
+  double seconds = timer.seconds();
+  bench::Allocations after = bench::allocations();
+
+  std::printf("lookup: %zu keys in %zu bytes (checksum %zu)\n", keys.size(),
+              input.size(), checksum);
+  std::printf("  getTableValue %8.0f ns/lookup  %.2f allocations/lookup\n",
+              seconds * 1e9 / keys.size(),
+              double(after.count - before.count) / keys.size());
+
+  const Document& document = parser.getDocument();
+  before = bench::allocations();
+  timer = bench::Timer();
+  for (int round = 0; round < 100; ++round) {
+    for (const auto& key : keys) {
+      checksum += document.find(key) != nullptr;
+    }
+  }
+  seconds = timer.seconds() / 100;
+  after = bench::allocations();
+  std::printf("  find          %8.0f ns/lookup  %.2f allocations/lookup\n",
+              seconds * 1e9 / keys.size(),
+              double(after.count - before.count) / (100 * keys.size()));
+
+  before = bench::allocations();
+  timer = bench::Timer();
+  for (int round = 0; round < 100; ++round) {
+    for (const auto& key : keys) {
+      checksum += parser.get<int64_t>(key).value_or(0);
+    }
+  }
+  seconds = timer.seconds() / 100;
+  after = bench::allocations();
+  std::printf("  get<int64_t>  %8.0f ns/lookup  %.2f allocations/lookup\n",
+              seconds * 1e9 / keys.size(),
+              double(after.count - before.count) / (100 * keys.size()));
+
+  std::vector<KeyHandle> handles;
+  for (const auto& key : keys) {
+    handles.push_back(parser.compile(key));
+  }
+  before = bench::allocations();
+  timer = bench::Timer();
+  for (int round = 0; round < 100; ++round) {
+    for (const auto& handle : handles) {
+      checksum += parser.get<int64_t>(handle).value_or(0);
+    }
+  }
+  seconds = timer.seconds() / 100;
+  after = bench::allocations();
+  std::printf("  KeyHandle     %8.0f ns/lookup  %.2f allocations/lookup\n",
+              seconds * 1e9 / keys.size(),
+              double(after.count - before.count) / (100 * keys.size()));
+}
+
+// One measured phase of one corpus, printed as a line of JSON.
+struct PhaseResult {
+  const char* phase;
+  size_t runs = 0;
+  double seconds = 1e30;  // the fastest run
+  size_t items = 0;       // tokens, index entries or lookups
+  bench::Allocations allocations{};
+};
+
+static void printPhase(const std::string& corpus, size_t bytes,
+                       const PhaseResult& result, bool throughput) {
+  char rate[32] = "null";
+  if (throughput) {
+    std::snprintf(rate, sizeof(rate), "%.2f",
+                  bytes / (1024.0 * 1024.0) / result.seconds);
+  }
+  std::printf(
+      "{\"corpus\":\"%s\",\"bytes\":%zu,\"phase\":\"%s\",\"runs\":%zu,"
+      "\"seconds\":%.9f,\"mb_per_s\":%s,\"items\":%zu,"
+      "\"allocations\":%llu,\"allocated_bytes\":%llu}\n",
+      corpus.c_str(), bytes, result.phase, result.runs, result.seconds, rate,
+      result.items, (unsigned long long)result.allocations.count,
+      (unsigned long long)result.allocations.bytes);
+}
+
+// Runs `step` `runs` times, keeping the fastest time and the allocations of
+// the last run. `step` returns the number of items it handled.
+template <typename Step>
+static PhaseResult measure(const char* phase, size_t runs, Step step) {
+  PhaseResult result;
+  result.phase = phase;
+  result.runs = runs;
+  for (size_t run = 0; run < runs; ++run) {
+    bench::Allocations before = bench::allocations();
+    bench::Timer timer;
+    result.items = step();
+    result.seconds = std::min(result.seconds, timer.seconds());
+    bench::Allocations after = bench::allocations();
+    result.allocations = {after.count - before.count,
+                          after.bytes - before.bytes};
+  }
+  return result;
+}
+
+// Measures each phase of loading `input` separately: bringing the file
+// into memory (read, map), lexing every token up front (lex), walking the
+// tokens through the streaming accessors the parser uses (tokens), building
+// the document (parse) and looking up keys in it (lookup).
+static void benchPhases(const std::string& corpus, const std::string& input) {
+  const char* path = "gtoml_bench.corpus";
+  std::FILE* file = std::fopen(path, "wb");
+  std::fwrite(input.data(), 1, input.size(), file);
+  std::fclose(file);
+
+  // Small inputs are repeated for a stable time; large ones run three times.
+  size_t runs = std::max<size_t>(3, std::min<size_t>(200, (64 << 20) /
+                                                              (input.size() + 1)));
+  auto source = Source::borrow(input);
+  size_t bytes = input.size();
+
+  printPhase(corpus, bytes, measure("read", runs, [&] {
+               return Source::read(path)->view().size();
+             }), true);
+  printPhase(corpus, bytes, measure("map", runs, [&] {
+               return Source::map(path)->view().size();
+             }), true);
+  std::remove(path);
+
+  printPhase(corpus, bytes, measure("lex", runs, [&] {
+               Lexer lexer(source);
+               lexer.lex();
+               return lexer.tokenCount();
+             }), true);
+  printPhase(corpus, bytes, measure("tokens", runs, [&] {
+               Lexer lexer(source);
+               size_t tokens = 0;
+               while (lexer.GetCurrentToken().type != Token::EoF) {
+                 ++tokens;
+                 ++lexer.currentTokenIndex;
+               }
+               return tokens;
+             }), true);
+  printPhase(corpus, bytes, measure("parse", runs, [&] {
+               Parser parser(source);
+               return parser.getDocument().index.size();
+             }), true);
+
+  Parser parser(source);
+  if (!parser.getError().empty()) {
+    std::fprintf(stderr, "%s does not parse: %s\n", corpus.c_str(),
+                 parser.getError().c_str());
+  }
+  const Document& document = parser.getDocument();
+  std::vector<std::string> paths;
+  document.index.forEach([&](std::string_view path, const Value&) {
+    paths.emplace_back(path);
+  });
+  std::sort(paths.begin(), paths.end());
+  size_t stride = std::max<size_t>(1, paths.size() / 4096);
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < paths.size(); i += stride) {
+    keys.push_back(paths[i]);
+  }
+  size_t found = 0;
+  PhaseResult lookup = measure("lookup", runs, [&] {
+    for (const auto& key : keys) {
+      found += document.find(key) != nullptr;
+    }
+    return keys.size();
+  });
+  printPhase(corpus, bytes, lookup, false);
+}
+
+// Parses a size such as 65536, 64K, 16M or 1G.
+static size_t parseSize(const char* text) {
+  char* end = nullptr;
+  size_t size = std::strtoull(text, &end, 10);
+  switch (end ? *end : '\0') {
+    case 'K':
+    case 'k':
+      return size << 10;
+    case 'M':
+    case 'm':
+      return size << 20;
+    case 'G':
+    case 'g':
+      return size << 30;
+    default:
+      return size;
+  }
+}
+
+// gtoml_bench [bytes]
+//   Runs every benchmark on a generated config of `bytes` (16M by
+//   default) and prints a readable report.
+// gtoml_bench --phases [--corpus kind,...] [size...]
+//   Prints one JSON line per corpus, size and phase: read, map, lex,
+//   tokens, parse and lookup, with MB/s and allocations. Sizes default to
+//   64K 1M 16M; corpora to all of config, wide, deep, arrays, strings,
+//   comments and numbers.
+// gtoml_bench --generate kind size path
+//   Writes a generated corpus to `path`, to benchmark other tools on it.
+int main(int argc, char** argv) {
+  if (argc > 1 && std::string(argv[1]) == "--generate") {
+    std::string corpus =
+        argc == 5 ? bench::generateCorpus(argv[2], parseSize(argv[3])) : "";
+    std::FILE* file = corpus.empty() ? nullptr : std::fopen(argv[4], "wb");
+    if (!file) {
+      std::fprintf(stderr, "usage: gtoml_bench --generate kind size path\n");
+      return 1;
+    }
+    std::fwrite(corpus.data(), 1, corpus.size(), file);
+    std::fclose(file);
+    return 0;
+  }
+
+  if (argc > 1 && std::string(argv[1]) == "--phases") {
+    std::vector<std::string> corpora = {"config",  "wide",     "deep",
+                                        "arrays",  "strings",  "comments",
+                                        "numbers"};
+    std::vector<size_t> sizes;
+    for (int i = 2; i < argc; ++i) {
+      if (std::string(argv[i]) == "--corpus" && i + 1 < argc) {
+        corpora.clear();
+        std::string list = argv[++i];
+        for (size_t at = 0; at <= list.size();) {
+          size_t comma = std::min(list.find(',', at), list.size());
+          corpora.push_back(list.substr(at, comma - at));
+          at = comma + 1;
+        }
+      } else {
+        sizes.push_back(parseSize(argv[i]));
+      }
+    }
+    if (sizes.empty()) {
+      sizes = {64 << 10, 1 << 20, 16 << 20};
+    }
+    for (const auto& corpus : corpora) {
+      for (size_t size : sizes) {
+        std::string input = bench::generateCorpus(corpus, size);
+        if (input.empty()) {
+          std::fprintf(stderr, "unknown corpus %s\n", corpus.c_str());
+          return 1;
+        }
+        benchPhases(corpus, input);
+      }
+    }
+    return 0;
+  }
+
+  size_t bytes = 16 * 1024 * 1024;
+  if (argc > 1) {
+    bytes = parseSize(argv[1]);
+  }
+
+  std::string input = bench::generateConfig(bytes);
+  benchTokens(input);
+  benchParse("config", input);
+  benchParse("numbers", bench::generateNumbers(bytes));
+  benchLookup(input);
+  benchBind();
+  benchEvents(input);
+  benchEmit(input);
+  benchParallel("config", input);
+  benchBatch(4000);
+  benchSnapshot(input);
+  benchLazy(input);
+  benchStats(input);
+  benchEdit(input);
+  benchReload();
+  std::string strings = bench::generateStringsAndComments(bytes);
+  benchMemory("config", input);
+  benchMemory("strings+comments", strings);
+  benchLex("config", input);
+  benchLex("strings+comments", strings);
+  return 0;
+}
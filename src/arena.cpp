@@ -0,0 +1,69 @@
+#include "arena.hpp"
+
+#include <algorithm>
+
+using namespace GTOML;
+
+Arena& Arena::operator=(Arena&& other) noexcept {
+  if (this != &other) {
+    release();
+    cursor = std::exchange(other.cursor, nullptr);
+    end = std::exchange(other.end, nullptr);
+    chunks = std::exchange(other.chunks, nullptr);
+    nextChunk = std::exchange(other.nextChunk, kFirstChunk);
+    reserved = std::exchange(other.reserved, 0);
+  }
+  return *this;
+}
+
+void Arena::adopt(Arena&& other) {
+  if (this == &other || !other.chunks) {
+    return;
+  }
+  // Splice the chunks in behind the current one, which keeps serving
+  // allocations.
+  Chunk* tail = other.chunks;
+  while (tail->next) {
+    tail = tail->next;
+  }
+  if (chunks) {
+    tail->next = chunks->next;
+    chunks->next = other.chunks;
+  } else {
+    chunks = other.chunks;
+    cursor = other.cursor;
+    end = other.end;
+  }
+  reserved += other.reserved;
+
+  other.chunks = nullptr;
+  other.cursor = other.end = nullptr;
+  other.nextChunk = kFirstChunk;
+  other.reserved = 0;
+}
+
+void Arena::release() {
+  while (chunks) {
+    Chunk* next = chunks->next;
+    ::operator delete(chunks);
+    chunks = next;
+  }
+  cursor = end = nullptr;
+  nextChunk = kFirstChunk;
+  reserved = 0;
+}
+
+void* Arena::allocateSlow(size_t size, size_t align) {
+  size_t needed = sizeof(Chunk) + size + align;
+  size_t chunkSize = std::max(nextChunk, needed);
+  nextChunk = std::min(nextChunk * 2, kMaxChunk);
+
+  Chunk* chunk = static_cast<Chunk*>(::operator new(chunkSize));
+  chunk->next = chunks;
+  chunks = chunk;
+  reserved += chunkSize;
+
+  cursor = reinterpret_cast<char*>(chunk + 1);
+  end = reinterpret_cast<char*>(chunk) + chunkSize;
+  return allocate(size, align);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <utility>
+
+namespace GTOML {
+// A run of items stored in an Arena.
+template <typename T>
+struct Span {
+  T* items = nullptr;
+  size_t count = 0;
+
+  T* begin() const { return items; }
+  T* end() const { return items + count; }
+  T& operator[](size_t i) const { return items[i]; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+};
+
+// A bump allocator. Objects are placed one after another in large chunks and
+// are never destroyed individually: destructors do not run, and all memory
+// is returned at once when the arena goes away. Only trivially destructible
+// data (or data whose memory also lives in the arena) may be stored here.
+class Arena {
+ public:
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  Arena(Arena&& other) noexcept { *this = std::move(other); }
+  Arena& operator=(Arena&& other) noexcept;
+  ~Arena() { release(); }
+
+  void* allocate(size_t size, size_t align) {
+    size_t padding = -reinterpret_cast<uintptr_t>(cursor) & (align - 1);
+    if (size + padding > static_cast<size_t>(end - cursor)) {
+      return allocateSlow(size, align);
+    }
+    void* p = cursor + padding;
+    cursor += padding + size;
+    return p;
+  }
+
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+
+  // Copies `count` items into the arena.
+  template <typename T>
+  T* copy(const T* items, size_t count) {
+    if (count == 0) {
+      return nullptr;
+    }
+    T* p = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    std::memcpy(p, items, sizeof(T) * count);
+    return p;
+  }
+
+  std::string_view copy(std::string_view text) {
+    return {copy(text.data(), text.size()), text.size()};
+  }
+
+  // Takes over every chunk of `other`, leaving it empty. Pointers into
+  // `other` stay valid and now live as long as this arena.
+  void adopt(Arena&& other);
+
+  // Frees every chunk; all pointers into the arena become invalid.
+  void release();
+
+  // Bytes requested from the heap so far.
+  size_t bytesReserved() const { return reserved; }
+
+ private:
+  struct Chunk {
+    Chunk* next;
+  };
+
+  void* allocateSlow(size_t size, size_t align);
+
+  static constexpr size_t kFirstChunk = 4096;
+  static constexpr size_t kMaxChunk = 1 << 20;
+
+  char* cursor = nullptr;
+  char* end = nullptr;
+  Chunk* chunks = nullptr;
+  size_t nextChunk = kFirstChunk;
+  size_t reserved = 0;
+};
+}  // namespace GTOML
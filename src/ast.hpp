@@ -1,76 +1,157 @@
-#include <vector>
-#include <string>
-#include <memory>
-#include <map>
-
-class TOMLNode {
-public:
-    virtual ~TOMLNode() {};
-
-    bool inside_table = false;
-    std::string table_name;
-
-};
-
-// AST node for key-value pairs
-class KeyValueNode : public TOMLNode {
-public:
-    KeyValueNode(const std::string& key, std::shared_ptr<TOMLNode> value)
-        : key(key), value(value) {}
-
-    std::string key;
-    std::shared_ptr<TOMLNode> value;
-};
-
-// AST node for string values
-class StringNode : public TOMLNode {
-public:
-    StringNode(const std::string& value) : value(value) {}
-
-    std::string value;
-};
-
-// AST node for integer values
-class IntegerNode : public TOMLNode {
-public:
-    IntegerNode(int value) : value(value) {}
-
-    int value;
-};
-
-// AST node for TOML tables
-class TableNode : public TOMLNode {
-public:
-    TableNode(const std::vector<std::shared_ptr<TOMLNode>>& entries)
-        : entries(entries) {}
-
-    std::vector<std::shared_ptr<TOMLNode>> entries;
-    std::string name;
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "arena.hpp"
+
+namespace GTOML {
+enum class Kind : uint8_t {
+  None,  // a missing value, or the result of a parse error
+  String,
+  Integer,
+  Float,
+  Bool,
+  Array,
+  Table,
 };
 
-// AST node for boolean values
-class BoolNode : public TOMLNode {
-public:
-    BoolNode(bool value) : value(value) {}
-
-    bool value;
+struct KeyValue;
+
+// A TOML value in 16 bytes: a kind tag plus inline storage for scalars, or a
+// pointer and length for strings, arrays and tables. Strings, array items and
+// table entries all live in the Document's arena.
+// Inspect kind() and switch on it before calling an accessor.
+class Value {
+ public:
+  Value() : length(0), tag(Kind::None) { data.integer = 0; }
+
+  static Value string(std::string_view text) {
+    Value v(Kind::String);
+    v.data.chars = text.data();
+    v.length = static_cast<uint32_t>(text.size());
+    return v;
+  }
+  static Value integer(int64_t integer) {
+    Value v(Kind::Integer);
+    v.data.integer = integer;
+    return v;
+  }
+  static Value floating(double floating) {
+    Value v(Kind::Float);
+    v.data.floating = floating;
+    return v;
+  }
+  static Value boolean(bool boolean) {
+    Value v(Kind::Bool);
+    v.data.boolean = boolean;
+    return v;
+  }
+  static Value array(Span<Value> items) {
+    Value v(Kind::Array);
+    v.data.items = items.begin();
+    v.length = static_cast<uint32_t>(items.size());
+    return v;
+  }
+  static Value table(Span<KeyValue> entries) {
+    Value v(Kind::Table);
+    v.data.entries = entries.begin();
+    v.length = static_cast<uint32_t>(entries.size());
+    return v;
+  }
+
+  Kind kind() const { return tag; }
+  bool isNone() const { return tag == Kind::None; }
+
+  std::string_view asString() const { return {data.chars, length}; }
+  int64_t asInteger() const { return data.integer; }
+  double asFloat() const { return data.floating; }
+  bool asBool() const { return data.boolean; }
+  Span<const Value> asArray() const { return {data.items, length}; }
+  Span<const KeyValue> asTable() const { return {data.entries, length}; }
+
+  // Typed access that checks the kind first: int64_t, double (integers
+  // widen), bool, std::string_view, ArrayView and TableView. Returns nullopt
+  // on a kind mismatch.
+  template <typename T>
+  std::optional<T> as() const;
+
+ private:
+  explicit Value(Kind kind) : length(0), tag(kind) {}
+
+  union {
+    bool boolean;
+    int64_t integer;
+    double floating;
+    const char* chars;
+    const Value* items;
+    const KeyValue* entries;
+  } data;
+  uint32_t length;
+  Kind tag;
 };
 
-// AST node for float values
-class FloatNode : public TOMLNode {
-public:
-    FloatNode(const std::string& value) : value(value) {}
-
-    std::string value;
-};
-
-// AST node for array
-class ArrayNode : public TOMLNode {
-public:
-    ArrayNode(const std::string& name, const std::vector<std::shared_ptr<TOMLNode>>& elements)
-        : array_name(name), elements(elements) {}
-
-    const std::string array_name;
-    std::vector<std::shared_ptr<TOMLNode>> elements;
+static_assert(sizeof(Value) == 16, "Value must stay 16 bytes");
+
+template <>
+inline std::optional<int64_t> Value::as<int64_t>() const {
+  if (tag != Kind::Integer) {
+    return std::nullopt;
+  }
+  return data.integer;
+}
+
+template <>
+inline std::optional<double> Value::as<double>() const {
+  if (tag == Kind::Integer) {
+    return static_cast<double>(data.integer);
+  }
+  if (tag != Kind::Float) {
+    return std::nullopt;
+  }
+  return data.floating;
+}
+
+template <>
+inline std::optional<bool> Value::as<bool>() const {
+  if (tag != Kind::Bool) {
+    return std::nullopt;
+  }
+  return data.boolean;
+}
+
+template <>
+inline std::optional<std::string_view> Value::as<std::string_view>() const {
+  if (tag != Kind::String) {
+    return std::nullopt;
+  }
+  return asString();
+}
+
+template <>
+inline std::optional<Span<const Value>> Value::as<Span<const Value>>() const {
+  if (tag != Kind::Array) {
+    return std::nullopt;
+  }
+  return asArray();
+}
+
+// A key and its value. Tables are stored as a key whose value is a table, so
+// the document root and every table body are runs of KeyValues.
+struct KeyValue {
+  std::string_view key;
+  Value value;
 };
 
+typedef Span<const Value> ArrayView;
+typedef Span<const KeyValue> TableView;
+
+template <>
+inline std::optional<Span<const KeyValue>> Value::as<Span<const KeyValue>>()
+    const {
+  if (tag != Kind::Table) {
+    return std::nullopt;
+  }
+  return asTable();
+}
+}  // namespace GTOML
@@ -0,0 +1,94 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+
+#include "parser.hpp"
+
+using namespace GTOML;
+
+namespace {
+// The inputs dealt to one worker. The owner and any thief claim inputs from
+// the front with the same fetch_add, so an input is parsed exactly once.
+struct alignas(64) Run {
+  std::atomic<size_t> next{0};
+  size_t end = 0;
+};
+}  // namespace
+
+BatchLoader::BatchLoader(unsigned threads)
+    : threads(threads ? threads
+                      : std::max(1u, std::thread::hardware_concurrency())) {}
+
+template <typename Open>
+void BatchLoader::run(std::vector<BatchResult>& results, Open open) {
+  size_t count = results.size();
+  size_t workers = std::min<size_t>(threads, count);
+  if (workers == 0) {
+    return;
+  }
+
+  std::unique_ptr<Run[]> runs(new Run[workers]);
+  for (size_t w = 0; w < workers; ++w) {
+    runs[w].next = count * w / workers;
+    runs[w].end = count * (w + 1) / workers;
+  }
+
+  auto work = [&](size_t self) {
+    Parser parser{Parser::Worker()};
+    for (size_t k = 0; k < workers; ++k) {
+      Run& run = runs[(self + k) % workers];
+      for (size_t i; (i = run.next++) < run.end;) {
+        BatchResult& result = results[i];
+        // An exception must not escape the thread, which would terminate
+        // the process; it fails this input only.
+        try {
+          std::shared_ptr<const Source> source = open(i);
+          if (!source) {
+            result.error = "File " + result.path + " cannot be read";
+          } else if (parser.reparse(source)) {
+            result.document = std::move(*parser.document);
+          } else {
+            result.error = parser.getError();
+          }
+        } catch (const std::exception& e) {
+          result.document = Document();
+          result.error = "Could not load " + result.path + ": " + e.what();
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (size_t w = 1; w < workers; ++w) {
+    pool.emplace_back(work, w);
+  }
+  work(0);
+  for (auto& thread : pool) {
+    thread.join();
+  }
+}
+
+std::vector<BatchResult> BatchLoader::loadFiles(
+    const std::vector<std::string>& paths, Input input) {
+  std::vector<BatchResult> results(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i) {
+    results[i].path = paths[i];
+  }
+  run(results, [&](size_t i) {
+    return input == Input::Map ? Source::map(paths[i]) : Source::read(paths[i]);
+  });
+  return results;
+}
+
+std::vector<BatchResult> BatchLoader::loadBuffers(
+    const std::vector<std::string_view>& buffers) {
+  // Documents copy what they keep out of the source, so the buffers only
+  // need to outlive this call.
+  std::vector<BatchResult> results(buffers.size());
+  run(results, [&](size_t i) { return Source::borrow(buffers[i]); });
+  return results;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.hpp"
+#include "source.hpp"
+
+namespace GTOML {
+// The outcome of one input of a batch. A file that cannot be opened or does
+// not parse leaves an empty document and the first error; the other inputs
+// of the batch are not affected.
+struct BatchResult {
+  std::string path;  // empty for in-memory buffers
+  Document document;
+  std::string error;  // "" when the input parsed
+
+  bool ok() const { return error.empty(); }
+};
+
+// Parses many small documents concurrently, e.g. a directory of several
+// thousand config files read at startup. Each worker keeps one Parser and
+// reuses its scratch buffers for every input it handles. Inputs are dealt out
+// to the workers in contiguous runs; a worker that finishes its run steals
+// the remaining inputs of the others, so one slow file does not hold up the
+// rest. Nothing is printed: errors are returned with the results.
+class BatchLoader {
+ public:
+  // `threads` == 0 uses one worker per hardware thread.
+  explicit BatchLoader(unsigned threads = 0);
+
+  // Results are in the order of the inputs.
+  std::vector<BatchResult> loadFiles(const std::vector<std::string>& paths,
+                                     Input input = Input::Read);
+  std::vector<BatchResult> loadBuffers(
+      const std::vector<std::string_view>& buffers);
+
+ private:
+  // Parses results[i] from open(i) on the worker pool.
+  template <typename Open>
+  void run(std::vector<BatchResult>& results, Open open);
+
+  unsigned threads;
+};
+}  // namespace GTOML
@@ -0,0 +1,246 @@
+#include "bind.hpp"
+
+using namespace GTOML;
+
+namespace {
+const char* kindName(Kind kind) {
+  switch (kind) {
+    case Kind::String:
+      return "string";
+    case Kind::Integer:
+      return "integer";
+    case Kind::Float:
+      return "float";
+    case Kind::Bool:
+      return "bool";
+    case Kind::Array:
+      return "array";
+    case Kind::Table:
+      return "table";
+    default:
+      return "nothing";
+  }
+}
+
+// Where the value of a key that names a bound struct would go: it takes a
+// table, so any value is a mismatch.
+const Slot kTableSlot{
+    "table",
+    [](Binder& binder, void*, const Value& value) {
+      return binder.mismatch("table", value);
+    },
+    [](Binder& binder, void*) {
+      return binder.mismatch("table", Value::array({}));
+    }};
+}  // namespace
+
+size_t Schema::find(std::string_view name) const {
+  for (size_t i = 0; i < fields.size(); ++i) {
+    if (fields[i].name == name) {
+      return i;
+    }
+  }
+  return SIZE_MAX;
+}
+
+bool Binder::run(std::shared_ptr<const Source> source, const Schema& schema,
+                 void* object) {
+  frame = frameFor(object, schema);
+  std::string syntax;
+  if (!parseEvents(std::move(source), *this, &syntax)) {
+    // A syntax error, or an error of ours that stopped the parse.
+    fail(syntax);
+    return false;
+  }
+  return checkGiven(0, schema, object, "");
+}
+
+bool Binder::onTableBegin(std::string_view name) {
+  table = name;
+  key = {};
+  frame = 0;
+  for (size_t dot; (dot = name.find('.')) != std::string_view::npos;) {
+    if (!child(frame, name.substr(0, dot))) {
+      return false;
+    }
+    name = name.substr(dot + 1);
+  }
+  return child(frame, name);
+}
+
+// Finds the member of `key`, following a dotted key into nested tables.
+bool Binder::onKey(std::string_view name) {
+  key = name;
+  targetSlot = nullptr;
+  size_t within = frame;
+  for (size_t dot; (dot = name.find('.')) != std::string_view::npos;) {
+    if (!child(within, name.substr(0, dot))) {
+      return false;
+    }
+    name = name.substr(dot + 1);
+  }
+  if (within == kSkip) {
+    return true;
+  }
+  Frame current = frames[within];
+  size_t field = current.schema->find(name);
+  // Keys no struct describes are skipped, and so is a key given again: the
+  // first definition wins.
+  if (field == SIZE_MAX || given[current.seen + field]) {
+    return true;
+  }
+  const Schema::Field& found = current.schema->fields[field];
+  if (!found.slot) {
+    targetSlot = &kTableSlot;
+    return true;
+  }
+  given[current.seen + field] = true;
+  target = found.locate(current.object, found);
+  targetSlot = found.slot;
+  return true;
+}
+
+bool Binder::onScalar(const Value& value) {
+  void* member;
+  const Slot* slot = destination(member);
+  return !slot || slot->scalar(*this, member, value);
+}
+
+bool Binder::onArrayBegin() {
+  void* member;
+  const Slot* slot = destination(member);
+  if (!slot) {
+    ++skipped;
+    return true;
+  }
+  return slot->array(*this, member);
+}
+
+bool Binder::onArrayEnd() {
+  if (skipped > 0) {
+    --skipped;
+  } else {
+    arrays.pop_back();
+  }
+  return true;
+}
+
+// Where the value that starts now goes: the next item of the innermost
+// bound array, or the member of the current key. Returns nullptr when the
+// value is skipped.
+const Slot* Binder::destination(void*& member) {
+  if (skipped > 0) {
+    return nullptr;
+  }
+  if (!arrays.empty()) {
+    OpenArray& open = arrays.back();
+    member = open.append(open.items);
+    return open.slot;
+  }
+  member = target;
+  return targetSlot;
+}
+
+// The frame of the struct at `object`. A struct and its first member share
+// an address, so the schema tells them apart.
+size_t Binder::frameFor(void* object, const Schema& schema) {
+  for (size_t i = 0; i < frames.size(); ++i) {
+    if (frames[i].object == object && frames[i].schema == &schema) {
+      return i;
+    }
+  }
+  frames.push_back({object, &schema, given.size()});
+  given.resize(given.size() + schema.fields.size());
+  return frames.size() - 1;
+}
+
+// Moves `frame` to the table `name` within it, or to kSkip if no struct
+// describes that table. Fails if `name` is a field that holds a value.
+bool Binder::child(size_t& frame, std::string_view name) {
+  if (frame == kSkip) {
+    return true;
+  }
+  Frame current = frames[frame];
+  size_t field = current.schema->find(name);
+  if (field == SIZE_MAX) {
+    frame = kSkip;
+    return true;
+  }
+  const Schema::Field& found = current.schema->fields[field];
+  if (!found.table) {
+    fail("Expected " + std::string(found.expects()) + " for " +
+         path(name.data() + name.size()) + " but got table");
+    return false;
+  }
+  given[current.seen + field] = true;
+  frame = frameFor(found.locate(current.object, found), *found.table);
+  return true;
+}
+
+// Fails on the first required field, in declaration order, that was not
+// given, looking into every struct whose table was given.
+bool Binder::checkGiven(size_t frame, const Schema& schema, void* object,
+                        const std::string& prefix) {
+  for (size_t i = 0; i < schema.fields.size(); ++i) {
+    const Schema::Field& field = schema.fields[i];
+    std::string name = prefix + field.name;
+    if (frame == kSkip || !given[frames[frame].seen + i]) {
+      if (field.required) {
+        fail("Missing " + std::string(field.table ? "table " : "key ") +
+             name);
+        return false;
+      }
+      continue;
+    }
+    if (field.table) {
+      void* member = field.locate(object, field);
+      size_t inner = kSkip;
+      for (size_t f = 0; f < frames.size(); ++f) {
+        if (frames[f].object == member && frames[f].schema == field.table) {
+          inner = f;
+        }
+      }
+      if (!checkGiven(inner, *field.table, member, name + ".")) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool Binder::mismatch(const char* expected, const Value& got) {
+  fail("Expected " + std::string(expected) + " for " + path() + " but got " +
+       kindName(got.kind()));
+  return false;
+}
+
+bool Binder::outOfRange(const Value& value) {
+  fail("Integer out of range for " + path() + ": " +
+       std::to_string(value.asInteger()));
+  return false;
+}
+
+// The dotted path of the key being bound, as the document would index it,
+// or of its prefix ending at `end` when a part of a dotted name is wrong.
+std::string Binder::path(const char* end) const {
+  std::string_view header = table;
+  std::string_view name = key;
+  if (end && key.empty()) {
+    header = header.substr(0, end - header.data());
+  } else if (end) {
+    name = name.substr(0, end - name.data());
+  }
+  if (header.empty()) {
+    return std::string(name);
+  }
+  if (name.empty()) {
+    return std::string(header);
+  }
+  return std::string(header) + "." + std::string(name);
+}
+
+void Binder::fail(const std::string& message) {
+  if (error.empty()) {
+    error = message;
+  }
+}
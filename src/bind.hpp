@@ -0,0 +1,355 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "ast.hpp"
+#include "events.hpp"
+#include "source.hpp"
+
+namespace GTOML {
+// Describes the fields of a struct for bind(). Specialize it once per
+// struct, naming each field and the member it is stored in:
+//
+//   template <>
+//   struct Binding<Server> {
+//     static void describe(Fields<Server>& fields) {
+//       fields.required("host", &Server::host)
+//           .required("port", &Server::port)
+//           .optional("tls", &Server::tls);
+//     }
+//   };
+//
+// Members may be integers of any width, floating point, bool, std::string,
+// std::optional and std::vector of those, and other bound structs, which
+// are filled from the table of the same name ([server] or [server.tls]).
+template <typename T>
+struct Binding;
+
+class Binder;
+
+// Stores the values bind() reads into members of type M. Each
+// specialization has the kind of value M takes, for error messages, and
+//
+//   static bool scalar(Binder&, M& out, const Value& value);
+//   static bool array(Binder&, M& out);
+//
+// scalar() stores a string, number or bool. array() is called at the start
+// of an array; an array member opens it with Binder::openArray() to have
+// the items stored, any other member reports a mismatch.
+template <typename M, typename = void>
+struct Assign;
+
+// Assign<M> with the member type erased, so that the binder itself is not
+// a template. Built once per type by slotOf().
+struct Slot {
+  const char* expects;
+  bool (*scalar)(Binder& binder, void* member, const Value& value);
+  bool (*array)(Binder& binder, void* member);
+};
+
+template <typename M>
+const Slot& slotOf() {
+  static const Slot slot{
+      Assign<M>::name,
+      [](Binder& binder, void* member, const Value& value) {
+        return Assign<M>::scalar(binder, *static_cast<M*>(member), value);
+      },
+      [](Binder& binder, void* member) {
+        return Assign<M>::array(binder, *static_cast<M*>(member));
+      }};
+  return slot;
+}
+
+// The fields of a bound struct with the member types erased. Built once
+// per struct by schemaOf().
+struct Schema {
+  struct Field {
+    std::string name;
+    bool required = false;
+    const Slot* slot = nullptr;     // how a value is stored in the member
+    const Schema* table = nullptr;  // or the schema of a bound struct member
+    void* (*locate)(void* object, const Field& field) = nullptr;
+    unsigned char member[16];  // the pointer to member, M T::*
+
+    const char* expects() const { return slot ? slot->expects : "table"; }
+  };
+
+  // The field called `name`, or its index in `fields`; SIZE_MAX if none.
+  size_t find(std::string_view name) const;
+
+  std::vector<Field> fields;
+};
+
+template <typename T, typename = void>
+struct IsBound : std::false_type {};
+template <typename T>
+struct IsBound<T, std::void_t<decltype(&Binding<T>::describe)>>
+    : std::true_type {};
+
+template <typename T>
+const Schema& schemaOf();
+
+// What Binding<T>::describe() is handed to list the fields of T.
+template <typename T>
+class Fields {
+ public:
+  explicit Fields(Schema& schema) : schema(schema) {}
+
+  // A field that must be present; bind() fails if it is missing.
+  template <typename M>
+  Fields& required(std::string name, M T::*member) {
+    add(std::move(name), member, true);
+    return *this;
+  }
+  // A field that may be left out, keeping the member's initial value.
+  template <typename M>
+  Fields& optional(std::string name, M T::*member) {
+    add(std::move(name), member, false);
+    return *this;
+  }
+
+ private:
+  template <typename M>
+  void add(std::string name, M T::*member, bool required) {
+    static_assert(sizeof(member) <= sizeof(Schema::Field::member),
+                  "pointer to member does not fit");
+    Schema::Field field;
+    field.name = std::move(name);
+    field.required = required;
+    std::memcpy(field.member, &member, sizeof(member));
+    field.locate = [](void* object, const Schema::Field& field) -> void* {
+      M T::*member;
+      std::memcpy(&member, field.member, sizeof(member));
+      return &(static_cast<T*>(object)->*member);
+    };
+    if constexpr (IsBound<M>::value) {
+      field.table = &schemaOf<M>();
+    } else {
+      field.slot = &slotOf<M>();
+    }
+    schema.fields.push_back(std::move(field));
+  }
+
+  Schema& schema;
+};
+
+template <typename T>
+const Schema& schemaOf() {
+  static const Schema schema = [] {
+    Schema built;
+    Fields<T> fields(built);
+    Binding<T>::describe(fields);
+    return built;
+  }();
+  return schema;
+}
+
+// Receives the events of a parse and stores each value straight into the
+// member its path names. No Document is built: strings are copied from the
+// source into their members, and nothing else is allocated per value.
+//
+// The parser's grammar drives it (see parseEvents), so the syntax, its
+// errors and the values accepted are the Parser's. A key given twice keeps
+// its first definition. Keys and tables the structs do not describe are
+// skipped.
+class Binder : public Handler {
+ public:
+  // Binds the whole of `source` into `object`, which `schema` describes,
+  // then checks that every required field was given.
+  bool run(std::shared_ptr<const Source> source, const Schema& schema,
+           void* object);
+
+  // The first error, or "" if binding succeeded.
+  const std::string& getError() const { return error; }
+
+  // For the Assign specializations.
+  bool mismatch(const char* expected, const Value& got);
+  bool outOfRange(const Value& value);
+  // Stores the items of the array that starts into `items`: append() adds
+  // one and returns it, and `slot` stores a value in it.
+  void openArray(void* items, void* (*append)(void* items),
+                 const Slot& slot) {
+    arrays.push_back({items, append, &slot});
+  }
+
+  bool onTableBegin(std::string_view name) override;
+  bool onKey(std::string_view name) override;
+  bool onScalar(const Value& value) override;
+  bool onArrayBegin() override;
+  bool onArrayEnd() override;
+
+ private:
+  // A bound struct reached so far, and which of its fields have been given.
+  struct Frame {
+    void* object;
+    const Schema* schema;
+    size_t seen;  // index of its first field in `given`
+  };
+  static constexpr size_t kSkip = SIZE_MAX;  // a table no struct describes
+
+  struct OpenArray {
+    void* items;
+    void* (*append)(void* items);
+    const Slot* slot;
+  };
+
+  size_t frameFor(void* object, const Schema& schema);
+  bool child(size_t& frame, std::string_view name);
+  const Slot* destination(void*& member);
+  bool checkGiven(size_t frame, const Schema& schema, void* object,
+                  const std::string& prefix);
+  std::string path(const char* end = nullptr) const;
+  void fail(const std::string& message);
+
+  std::string error;
+  std::vector<Frame> frames;
+  std::vector<bool> given;
+  size_t frame = 0;        // the struct of the current table
+  std::string_view table;  // the current table header, "" at the root
+  std::string_view key;    // the key being bound
+  // Where the value of the current key goes; a null slot skips it.
+  void* target = nullptr;
+  const Slot* targetSlot = nullptr;
+  std::vector<OpenArray> arrays;  // bound arrays being read
+  size_t skipped = 0;             // depth of the arrays being skipped
+};
+
+// Parses `source` straight into `out`, e.g.
+//
+//   Config config;
+//   std::string error;
+//   if (!bind(Source::map("service.toml"), config, &error)) { ... }
+//
+// Returns false on a syntax error, a value of the wrong kind or out of
+// range for its member, or a missing required field; the first of these is
+// stored in `error` if given. Members may have been assigned by then.
+template <typename T>
+bool bind(std::shared_ptr<const Source> source, T& out,
+          std::string* error = nullptr) {
+  Binder binder;
+  bool bound = binder.run(std::move(source), schemaOf<T>(), &out);
+  if (error) {
+    *error = binder.getError();
+  }
+  return bound;
+}
+
+template <typename M>
+struct Assign<M, std::enable_if_t<std::is_integral_v<M> &&
+                                  !std::is_same_v<M, bool>>> {
+  static constexpr const char* name = "integer";
+  static bool scalar(Binder& binder, M& out, const Value& value) {
+    if (value.kind() != Kind::Integer) {
+      return binder.mismatch(name, value);
+    }
+    int64_t integer = value.asInteger();
+    bool fits;
+    if constexpr (std::is_signed_v<M>) {
+      fits = integer >= std::numeric_limits<M>::min() &&
+             integer <= std::numeric_limits<M>::max();
+    } else {
+      fits = integer >= 0 &&
+             static_cast<uint64_t>(integer) <= std::numeric_limits<M>::max();
+    }
+    if (!fits) {
+      return binder.outOfRange(value);
+    }
+    out = static_cast<M>(integer);
+    return true;
+  }
+  static bool array(Binder& binder, M&) {
+    return binder.mismatch(name, Value::array({}));
+  }
+};
+
+template <typename M>
+struct Assign<M, std::enable_if_t<std::is_floating_point_v<M>>> {
+  static constexpr const char* name = "float";
+  static bool scalar(Binder& binder, M& out, const Value& value) {
+    std::optional<double> number = value.as<double>();
+    if (!number) {
+      return binder.mismatch(name, value);
+    }
+    out = static_cast<M>(*number);
+    return true;
+  }
+  static bool array(Binder& binder, M&) {
+    return binder.mismatch(name, Value::array({}));
+  }
+};
+
+template <>
+struct Assign<bool> {
+  static constexpr const char* name = "bool";
+  static bool scalar(Binder& binder, bool& out, const Value& value) {
+    if (value.kind() != Kind::Bool) {
+      return binder.mismatch(name, value);
+    }
+    out = value.asBool();
+    return true;
+  }
+  static bool array(Binder& binder, bool&) {
+    return binder.mismatch(name, Value::array({}));
+  }
+};
+
+template <>
+struct Assign<std::string> {
+  static constexpr const char* name = "string";
+  static bool scalar(Binder& binder, std::string& out, const Value& value) {
+    if (value.kind() != Kind::String) {
+      return binder.mismatch(name, value);
+    }
+    out.assign(value.asString());
+    return true;
+  }
+  static bool array(Binder& binder, std::string&) {
+    return binder.mismatch(name, Value::array({}));
+  }
+};
+
+template <typename M>
+struct Assign<std::optional<M>> {
+  static constexpr const char* name = Assign<M>::name;
+  static bool scalar(Binder& binder, std::optional<M>& out,
+                     const Value& value) {
+    if (!out) {
+      out.emplace();
+    }
+    return Assign<M>::scalar(binder, *out, value);
+  }
+  static bool array(Binder& binder, std::optional<M>& out) {
+    if (!out) {
+      out.emplace();
+    }
+    return Assign<M>::array(binder, *out);
+  }
+};
+
+template <typename M>
+struct Assign<std::vector<M>> {
+  static constexpr const char* name = "array";
+  static bool scalar(Binder& binder, std::vector<M>&, const Value& value) {
+    return binder.mismatch(name, value);
+  }
+  static bool array(Binder& binder, std::vector<M>& out) {
+    out.clear();
+    binder.openArray(
+        &out,
+        [](void* items) -> void* {
+          auto& vector = *static_cast<std::vector<M>*>(items);
+          vector.emplace_back();
+          return &vector.back();
+        },
+        slotOf<M>());
+    return true;
+  }
+};
+}  // namespace GTOML
@@ -0,0 +1,191 @@
+#include "document.hpp"
+
+#include <atomic>
+#include <functional>
+
+using namespace GTOML;
+
+bool PathIndex::insert(std::string_view path, Value value) {
+  return insert(path, value, std::hash<std::string_view>()(path));
+}
+
+bool PathIndex::insert(std::string_view path, Value value, size_t hash) {
+  if ((count + 1) * 4 > slots.size() * 3) {
+    grow();
+  }
+
+  size_t mask = slots.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    Slot& slot = slots[i];
+    if (slot.path.data() == nullptr) {
+      slot = {path, value, hash};
+      ++count;
+      return true;
+    }
+    if (slot.hash == hash && slot.path == path) {
+      ++rejected;
+      return false;
+    }
+  }
+}
+
+const Value* PathIndex::find(std::string_view path) const {
+  if (slots.empty()) {
+    return nullptr;
+  }
+
+  size_t hash = std::hash<std::string_view>()(path);
+  size_t mask = slots.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const Slot& slot = slots[i];
+    if (slot.path.data() == nullptr) {
+      return nullptr;
+    }
+    if (slot.hash == hash && slot.path == path) {
+      return &slot.value;
+    }
+  }
+}
+
+std::string_view InternPool::intern(std::string_view text, Arena& arena) {
+  ++interned;
+  size_t hash = std::hash<std::string_view>()(text);
+  Slot* slot = slotFor(text, hash);
+  if (slot->text.data() == nullptr) {
+    // Empty strings still need a non-null pointer to mark the slot used.
+    *slot = {text.empty() ? std::string_view("", 0) : arena.copy(text), hash};
+    ++count;
+    stored += text.size();
+  }
+  return slot->text;
+}
+
+void InternPool::merge(const InternPool& other) {
+  interned += other.interned;
+  for (const Slot& from : other.slots) {
+    if (from.text.data() == nullptr) {
+      continue;
+    }
+    Slot* slot = slotFor(from.text, from.hash);
+    if (slot->text.data() == nullptr) {
+      *slot = from;
+      ++count;
+      stored += from.text.size();
+    }
+  }
+}
+
+// Returns the slot holding `text`, or the empty slot where it belongs.
+InternPool::Slot* InternPool::slotFor(std::string_view text, size_t hash) {
+  if ((count + 1) * 4 > slots.size() * 3) {
+    grow();
+  }
+
+  size_t mask = slots.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    Slot& slot = slots[i];
+    if (slot.text.data() == nullptr ||
+        (slot.hash == hash && slot.text == text)) {
+      return &slot;
+    }
+  }
+}
+
+std::string_view InternPool::find(std::string_view text) const {
+  if (slots.empty()) {
+    return {};
+  }
+
+  size_t hash = std::hash<std::string_view>()(text);
+  size_t mask = slots.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const Slot& slot = slots[i];
+    if (slot.text.data() == nullptr) {
+      return {};
+    }
+    if (slot.hash == hash && slot.text == text) {
+      return slot.text;
+    }
+  }
+}
+
+void InternPool::grow() {
+  std::vector<Slot> old(slots.empty() ? 16 : slots.size() * 2);
+  old.swap(slots);
+
+  size_t mask = slots.size() - 1;
+  for (const Slot& slot : old) {
+    if (slot.text.data() == nullptr) {
+      continue;
+    }
+    size_t i = slot.hash & mask;
+    while (slots[i].text.data() != nullptr) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = slot;
+  }
+}
+
+bool PathIndex::erase(std::string_view path) {
+  if (slots.empty()) {
+    return false;
+  }
+
+  size_t hash = std::hash<std::string_view>()(path);
+  size_t mask = slots.size() - 1;
+  size_t i = hash & mask;
+  for (;; i = (i + 1) & mask) {
+    if (slots[i].path.data() == nullptr) {
+      return false;
+    }
+    if (slots[i].hash == hash && slots[i].path == path) {
+      break;
+    }
+  }
+
+  // Shift later members of the probe run back into the hole, so lookups
+  // never stop early at it.
+  for (size_t j = (i + 1) & mask; slots[j].path.data() != nullptr;
+       j = (j + 1) & mask) {
+    size_t home = slots[j].hash & mask;
+    bool between = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+    if (!between) {
+      slots[i] = slots[j];
+      i = j;
+    }
+  }
+  slots[i] = Slot{};
+  --count;
+  return true;
+}
+
+void PathIndex::merge(const PathIndex& other) {
+  rejected += other.rejected;
+  for (const Slot& slot : other.slots) {
+    if (slot.path.data() != nullptr) {
+      insert(slot.path, slot.value, slot.hash);
+    }
+  }
+}
+
+void PathIndex::grow() {
+  std::vector<Slot> old(slots.empty() ? 16 : slots.size() * 2);
+  old.swap(slots);
+
+  size_t mask = slots.size() - 1;
+  for (const Slot& slot : old) {
+    if (slot.path.data() == nullptr) {
+      continue;
+    }
+    size_t i = slot.hash & mask;
+    while (slots[i].path.data() != nullptr) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = slot;
+  }
+}
+
+uint64_t Document::nextGeneration() {
+  static std::atomic<uint64_t> counter{0};
+  return ++counter;
+}
@@ -0,0 +1,192 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arena.hpp"
+#include "ast.hpp"
+#include "source.hpp"
+
+namespace GTOML {
+// Maps full dotted paths to values. Open addressing with linear probing in
+// one flat array, so building it costs a handful of allocations rather than
+// one per key, and looking up a string_view never allocates.
+class PathIndex {
+ public:
+  // Adds `path` unless it is already present; the first definition wins.
+  bool insert(std::string_view path, Value value);
+  const Value* find(std::string_view path) const;
+  // Removes `path`. Other slots may move, so pointers returned by find()
+  // are invalidated.
+  bool erase(std::string_view path);
+  // Inserts every path of `other` as if its keys had been parsed after
+  // ours, without hashing the paths again.
+  void merge(const PathIndex& other);
+  size_t size() const { return count; }
+  // Inserts rejected because the path was already present, i.e. keys or
+  // tables defined more than once.
+  size_t shadowed() const { return rejected; }
+  // Heap bytes of the table.
+  size_t tableBytes() const { return slots.capacity() * sizeof(Slot); }
+
+  // Calls f(path, value) for every entry, in no particular order.
+  template <typename F>
+  void forEach(F f) const {
+    for (const Slot& slot : slots) {
+      if (slot.path.data() != nullptr) {
+        f(slot.path, slot.value);
+      }
+    }
+  }
+
+ private:
+  struct Slot {
+    std::string_view path;  // data() == nullptr marks an empty slot
+    Value value;
+    size_t hash;
+  };
+
+  bool insert(std::string_view path, Value value, size_t hash);
+  void grow();
+
+  std::vector<Slot> slots;
+  size_t count = 0;
+  size_t rejected = 0;
+};
+
+// Stores each distinct string once in the document's arena. Keys, table
+// names and string values all go through the pool, so the thousands of
+// repeats of a key in a generated config share one copy. Pools merged from
+// separate parses may still hold two copies of a string (see merge()), so
+// interned strings are compared by content, never by their data() pointers.
+class InternPool {
+ public:
+  // Returns the pooled copy of `text`, copying it into `arena` on first use.
+  std::string_view intern(std::string_view text, Arena& arena);
+  // Returns the pooled copy of `text`, or a null view if it was never
+  // interned. Never allocates.
+  std::string_view find(std::string_view text) const;
+
+  // Adds the strings of `other`, whose arena the caller has adopted.
+  // Strings already present stay where they are, so after merging the
+  // pools of a parallel parse, equal strings from different sections may
+  // still have different copies.
+  void merge(const InternPool& other);
+
+  size_t size() const { return count; }      // distinct strings
+  size_t bytes() const { return stored; }    // bytes of distinct strings
+  size_t requests() const { return interned; }  // calls to intern()
+  // Heap bytes of the table; the strings themselves are in the arena.
+  size_t tableBytes() const { return slots.capacity() * sizeof(Slot); }
+
+ private:
+  struct Slot {
+    std::string_view text;  // data() == nullptr marks an empty slot
+    size_t hash;
+  };
+
+  Slot* slotFor(std::string_view text, size_t hash);
+  void grow();
+
+  std::vector<Slot> slots;
+  size_t count = 0;
+  size_t stored = 0;
+  size_t interned = 0;
+};
+
+// A dotted path compiled once for repeated lookups. The first lookup resolves
+// the path through the index and caches the value's slot together with the
+// document's generation; later lookups against the same document are a
+// compare and a pointer load. Using the handle with a reparsed or different
+// document re-resolves it once. The cache is not synchronized, so give each
+// thread its own handles.
+class KeyHandle {
+ public:
+  explicit KeyHandle(std::string_view path) : path(path) {}
+
+  std::string_view getPath() const { return path; }
+
+ private:
+  friend class Document;
+
+  std::string path;
+  mutable const Value* slot = nullptr;  // nullptr when the path is missing
+  mutable uint64_t generation = 0;      // 0 means not resolved yet
+};
+
+// A parsed TOML document. Array items, table entries and every key and string
+// value live in the document's arena and the whole tree is released in one go
+// when the document is destroyed. The document does not refer to the text it
+// was parsed from, so the source can be dropped once parsing is done.
+// Once built, a document is only read: a const Document may be shared by any
+// number of threads without locks (KeyHandles excepted, see above).
+class Document {
+ public:
+  Arena arena;
+  std::vector<KeyValue> entries;  // top-level keys and tables in source order
+  InternPool strings;
+
+  // Every key by its full dotted path ("title", "package", "package.name").
+  // Paths of table entries are joined in the arena.
+  PathIndex index;
+
+  // The document this one was edited from while a snapshot of it was held
+  // (see Parser::applyEdit). Entries that were not edited still live in its
+  // arena.
+  std::shared_ptr<const Document> base;
+
+  // Unique across every document built in the process, so a KeyHandle can
+  // tell whether its cached slot belongs to this document.
+  uint64_t generation = nextGeneration();
+
+  // Returns the value at `path`, or nullptr if there is none.
+  const Value* find(std::string_view path) const { return index.find(path); }
+
+  // The value at `path` as T (see Value::as), or nullopt if the path is
+  // missing or holds a different kind. Never allocates.
+  template <typename T>
+  std::optional<T> get(std::string_view path) const {
+    const Value* value = find(path);
+    if (!value) {
+      return std::nullopt;
+    }
+    return value->as<T>();
+  }
+
+  // Returns a handle for `path`, already resolved against this document.
+  KeyHandle compile(std::string_view path) const {
+    KeyHandle handle(path);
+    find(handle);
+    return handle;
+  }
+
+  const Value* find(const KeyHandle& handle) const {
+    if (handle.generation != generation) {
+      handle.slot = index.find(handle.path);
+      handle.generation = generation;
+    }
+    return handle.slot;
+  }
+
+  template <typename T>
+  std::optional<T> get(const KeyHandle& handle) const {
+    const Value* value = find(handle);
+    if (!value) {
+      return std::nullopt;
+    }
+    return value->as<T>();
+  }
+
+  // Heap bytes held by the document itself: the arena, the entries and
+  // the hash tables of the pool and the index. A base document is not
+  // counted.
+  size_t memoryBytes() const {
+    return arena.bytesReserved() + entries.capacity() * sizeof(KeyValue) +
+           strings.tableBytes() + index.tableBytes();
+  }
+
+  static uint64_t nextGeneration();
+};
+}  // namespace GTOML
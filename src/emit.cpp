@@ -0,0 +1,284 @@
+#include "emit.hpp"
+
+#include <charconv>
+
+#include "lexer.hpp"
+#include "numbers.hpp"
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace GTOML;
+
+namespace {
+// Whether `name` reads back as a single IDENTIFIER: only bare characters,
+// and not something the lexer would take for a number or a boolean.
+bool isBareKey(std::string_view name) {
+  if (name.empty()) {
+    return false;
+  }
+  for (char c : name) {
+    if (charClass(c) != kBare) {
+      return false;
+    }
+  }
+  return Lexer::classify_token({Token::IDENTIFIER, name}) == Token::IDENTIFIER;
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+#if defined(_WIN32)
+    int written = ::_write(fd, data, static_cast<unsigned>(size));
+#else
+    ssize_t written = ::write(fd, data, size);
+#endif
+    if (written <= 0) {
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+}  // namespace
+
+Emitter::~Emitter() {
+  if (fd >= 0) {
+    flush();
+  }
+}
+
+Emitter& Emitter::document(const Document& document) {
+  for (const auto& entry : document.entries) {
+    if (entry.value.kind() == Kind::Table) {
+      table(entry.key);
+      for (const auto& child : entry.value.asTable()) {
+        key(child.key).value(child.value);
+      }
+    } else {
+      key(entry.key).value(entry.value);
+    }
+  }
+  return *this;
+}
+
+Emitter& Emitter::table(std::string_view name) {
+  if (!ok()) {
+    return *this;
+  }
+  if (depth > 0 || pendingKey) {
+    fail("Table " + std::string(name) + " inside a value");
+    return *this;
+  }
+  if (!isBareKey(name)) {
+    fail("Not a bare table name: " + std::string(name));
+    return *this;
+  }
+  if (started) {
+    buffer += '\n';
+  }
+  buffer += '[';
+  buffer.append(name.data(), name.size());
+  buffer += "]\n";
+  started = true;
+  return *this;
+}
+
+Emitter& Emitter::key(std::string_view key) {
+  if (!ok()) {
+    return *this;
+  }
+  if (depth > 0 || pendingKey) {
+    fail("Key " + std::string(key) + " inside a value");
+    return *this;
+  }
+  if (!isBareKey(key)) {
+    fail("Not a bare key: " + std::string(key));
+    return *this;
+  }
+  buffer.append(key.data(), key.size());
+  buffer += " = ";
+  pendingKey = true;
+  started = true;
+  return *this;
+}
+
+Emitter& Emitter::integer(int64_t value) {
+  if (beginValue()) {
+    char digits[24];
+    char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    buffer.append(digits, end - digits);
+    endValue();
+  }
+  return *this;
+}
+
+Emitter& Emitter::floating(double value) {
+  if (beginValue()) {
+    char digits[kMaxFloatChars];
+    buffer.append(digits, formatFloat(value, digits));
+    endValue();
+  }
+  return *this;
+}
+
+Emitter& Emitter::boolean(bool value) {
+  if (beginValue()) {
+    buffer += value ? "true" : "false";
+    endValue();
+  }
+  return *this;
+}
+
+Emitter& Emitter::string(std::string_view text) {
+  if (!beginValue()) {
+    return *this;
+  }
+  static const char kHex[] = "0123456789ABCDEF";
+  buffer += '"';
+  size_t plain = 0;  // start of the run not yet copied
+  for (size_t i = 0; i < text.size(); ++i) {
+    unsigned char c = text[i];
+    if (c >= 0x20 && c != '"' && c != '\\' && c != 0x7f) {
+      continue;
+    }
+    buffer.append(text.data() + plain, i - plain);
+    plain = i + 1;
+    switch (c) {
+      case '"':
+        buffer += "\\\"";
+        break;
+      case '\\':
+        buffer += "\\\\";
+        break;
+      case '\n':
+        buffer += "\\n";
+        break;
+      case '\r':
+        buffer += "\\r";
+        break;
+      case '\t':
+        buffer += "\\t";
+        break;
+      default:
+        buffer += "\\u00";
+        buffer += kHex[c >> 4];
+        buffer += kHex[c & 15];
+        break;
+    }
+  }
+  buffer.append(text.data() + plain, text.size() - plain);
+  buffer += '"';
+  endValue();
+  return *this;
+}
+
+Emitter& Emitter::beginArray() {
+  if (beginValue()) {
+    buffer += '[';
+    ++depth;
+    separate = false;
+  }
+  return *this;
+}
+
+Emitter& Emitter::endArray() {
+  if (!ok()) {
+    return *this;
+  }
+  if (depth == 0) {
+    fail("endArray() without beginArray()");
+    return *this;
+  }
+  buffer += ']';
+  --depth;
+  endValue();
+  return *this;
+}
+
+Emitter& Emitter::value(const Value& value) {
+  switch (value.kind()) {
+    case Kind::String:
+      return string(value.asString());
+    case Kind::Integer:
+      return integer(value.asInteger());
+    case Kind::Float:
+      return floating(value.asFloat());
+    case Kind::Bool:
+      return boolean(value.asBool());
+    case Kind::Array:
+      beginArray();
+      for (const auto& item : value.asArray()) {
+        this->value(item);
+      }
+      return endArray();
+    default:
+      if (ok()) {
+        fail("A table cannot be written as a value");
+      }
+      return *this;
+  }
+}
+
+bool Emitter::flush() {
+  if (fd >= 0 && !buffer.empty()) {
+    if (!writeAll(fd, buffer.data(), buffer.size()) && ok()) {
+      fail("Could not write to descriptor " + std::to_string(fd));
+    }
+    buffer.clear();
+  }
+  return ok();
+}
+
+void Emitter::clear() {
+  buffer.clear();
+  error.clear();
+  depth = 0;
+  separate = false;
+  pendingKey = false;
+  started = false;
+}
+
+bool Emitter::onTableBegin(std::string_view name) { return table(name).ok(); }
+bool Emitter::onKey(std::string_view key) { return this->key(key).ok(); }
+bool Emitter::onScalar(const Value& value) { return this->value(value).ok(); }
+bool Emitter::onArrayBegin() { return beginArray().ok(); }
+bool Emitter::onArrayEnd() { return endArray().ok(); }
+
+// Checks that a value may go here and writes the separator before it.
+bool Emitter::beginValue() {
+  if (!ok()) {
+    return false;
+  }
+  if (depth > 0) {
+    if (separate) {
+      buffer += ", ";
+    }
+  } else if (!pendingKey) {
+    fail("A value without a key");
+    return false;
+  }
+  return true;
+}
+
+// Ends a key's line once its whole value is written.
+void Emitter::endValue() {
+  if (depth > 0) {
+    separate = true;
+    return;
+  }
+  buffer += '\n';
+  pendingKey = false;
+  if (fd >= 0 && buffer.size() >= kFlushAt) {
+    flush();
+  }
+}
+
+void Emitter::fail(const std::string& message) {
+  if (error.empty()) {
+    error = message;
+  }
+}
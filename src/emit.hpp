@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "document.hpp"
+#include "events.hpp"
+
+namespace GTOML {
+// Writes TOML that the parser reads back to the same document. Output goes
+// into a growable buffer, which is kept between documents, or through that
+// buffer to a file descriptor in large writes. Numbers are formatted with
+// to_chars; nothing goes through iostreams.
+//
+// Either hand it a whole document:
+//
+//   Emitter out;
+//   out.document(parser.getDocument());
+//   std::string_view text = out.view();
+//
+// or build the output call by call, e.g. from generated data:
+//
+//   Emitter out(fd);
+//   out.key("title").string("routes");
+//   out.table("route_0").key("path").string("/v2").key("weight").integer(3);
+//   out.key("hosts").beginArray().string("a").string("b").endArray();
+//   out.flush();
+//
+// Keys after table() belong to that table, as they would in the text. A
+// call that would write something the parser cannot read, such as a value
+// without a key or a key that does not lex as one, sets the error and
+// turns every later call into a no-op; check ok() or getError() at the end.
+//
+// An Emitter is also a Handler: parseEvents(source, emitter) rewrites a
+// document in this layout without building it.
+class Emitter : public Handler {
+ public:
+  // Writes into the buffer only; see view().
+  Emitter() = default;
+  // Writes to `fd` whenever the buffer fills, and on flush(). The
+  // descriptor stays open.
+  explicit Emitter(int fd) : fd(fd) {}
+  Emitter(const Emitter&) = delete;
+  Emitter& operator=(const Emitter&) = delete;
+  ~Emitter() override;
+
+  // Writes the root keys, then every table, in the document's order.
+  Emitter& document(const Document& document);
+
+  Emitter& table(std::string_view name);
+  Emitter& key(std::string_view key);
+  Emitter& integer(int64_t value);
+  Emitter& floating(double value);
+  Emitter& boolean(bool value);
+  // Writes `text` in quotes, escaping quotes, backslashes and control
+  // characters, which the parser decodes back to `text`.
+  Emitter& string(std::string_view text);
+  Emitter& beginArray();
+  Emitter& endArray();
+  // Writes a parsed value; strings as string() writes them.
+  Emitter& value(const Value& value);
+
+  // Writes the buffer to the descriptor, if any. Returns ok().
+  bool flush();
+  // The output so far that has not been flushed.
+  std::string_view view() const { return buffer; }
+  // Starts over, keeping the buffer's memory.
+  void clear();
+
+  bool ok() const { return error.empty(); }
+  const std::string& getError() const { return error; }
+
+  bool onTableBegin(std::string_view name) override;
+  bool onKey(std::string_view key) override;
+  bool onScalar(const Value& value) override;
+  bool onArrayBegin() override;
+  bool onArrayEnd() override;
+
+ private:
+  static constexpr size_t kFlushAt = 64 * 1024;
+
+  bool beginValue();
+  void endValue();
+  void fail(const std::string& message);
+
+  std::string buffer;
+  int fd = -1;
+  std::string error;
+  size_t depth = 0;       // arrays open
+  bool separate = false;  // an item was written in the innermost array
+  bool pendingKey = false;
+  bool started = false;  // anything has been written
+};
+}  // namespace GTOML
@@ -0,0 +1,47 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "ast.hpp"
+#include "source.hpp"
+
+namespace GTOML {
+// Receives a document as the parser reads it, in source order, without a
+// Document being built. For
+//
+//   title = "x"
+//   [server]
+//   ports = [80, 443]
+//
+// the calls are onKey("title"), onScalar("x"), onTableBegin("server"),
+// onKey("ports"), onArrayBegin(), onScalar(80), onScalar(443), onArrayEnd(),
+// onTableEnd().
+//
+// Names, keys and string values are valid until the call returns. Names,
+// keys and strings without escapes are views into the source and stay valid
+// after that as long as the caller keeps the Source; a string with escapes
+// arrives decoded in a buffer that the next one reuses. Numbers arrive
+// already checked and converted.
+// Return false from any call to stop the parse there.
+class Handler {
+ public:
+  virtual ~Handler() = default;
+
+  virtual bool onTableBegin(std::string_view /*name*/) { return true; }
+  // After the last key of the table, before the next header or the end.
+  virtual bool onTableEnd() { return true; }
+  virtual bool onKey(std::string_view /*key*/) { return true; }
+  // A string, integer, float or bool: a key's value or an array item.
+  virtual bool onScalar(const Value& /*value*/) { return true; }
+  virtual bool onArrayBegin() { return true; }
+  virtual bool onArrayEnd() { return true; }
+};
+
+// Parses `source`, calling `handler` for every table, key and value, with
+// the grammar and errors of Parser. Nothing is allocated per key or value.
+// Returns false on a syntax error, stored in `error` if given, or when the
+// handler stopped the parse, in which case `error` is "".
+bool parseEvents(std::shared_ptr<const Source> source, Handler& handler,
+                 std::string* error = nullptr);
+}  // namespace GTOML
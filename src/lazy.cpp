@@ -0,0 +1,116 @@
+#include "lazy.hpp"
+
+#include <vector>
+
+#include "lexer.hpp"
+#include "parser.hpp"
+
+using namespace GTOML;
+
+namespace {
+// The bare name of the table whose '[' is at `at`, or "" if the header is
+// malformed; such a table is never a candidate for a lookup, just as the
+// eager parse would have failed on it.
+std::string_view headerName(std::string_view text, size_t at) {
+  size_t begin = at + 1;
+  while (begin < text.size() && charClass(text[begin]) == kBlank) {
+    ++begin;
+  }
+  size_t end = begin;
+  while (end < text.size() && charClass(text[end]) == kBare) {
+    ++end;
+  }
+  return text.substr(begin, end - begin);
+}
+}  // namespace
+
+LazyDocument::LazyDocument(std::shared_ptr<const Source> source)
+    : source(std::move(source)) {
+  if (!this->source) {
+    prelude.error = "No source to parse";
+    return;
+  }
+  std::string_view text = this->source->view();
+  std::vector<size_t> headers = Lexer::findTableHeaders(text);
+
+  prelude.end = headers.empty() ? text.size() : headers[0];
+  parseInto(prelude);
+
+  count = headers.size();
+  tables.reset(new Table[count]);
+  byName.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    tables[i].begin = headers[i];
+    tables[i].end = i + 1 < count ? headers[i + 1] : text.size();
+    auto named = byName.try_emplace(headerName(text, headers[i]), i, i);
+    if (!named.second) {
+      tables[named.first->second.second].next = i;
+      named.first->second.second = i;
+    }
+  }
+}
+
+const Value* LazyDocument::find(std::string_view path) const {
+  // The keys before the first table come first in the source, so they win.
+  if (prelude.document) {
+    if (const Value* value = prelude.document->find(path)) {
+      return value;
+    }
+  }
+
+  // The path names a table, or a key of a table whose name is a prefix of
+  // the path ending at a dot. The first table in source order that has it
+  // wins, so keep the earliest hit over every candidate name.
+  const Value* found = nullptr;
+  size_t foundTable = SIZE_MAX;
+  for (size_t dot = path.find('.');; dot = path.find('.', dot + 1)) {
+    auto named = byName.find(path.substr(0, dot));
+    if (named != byName.end()) {
+      for (size_t i = named->second.first; i < foundTable;
+           i = tables[i].next) {
+        const Document* document = materialize(tables[i]);
+        if (const Value* value = document ? document->find(path) : nullptr) {
+          found = value;
+          foundTable = i;
+        }
+      }
+    }
+    if (dot == std::string_view::npos) {
+      break;
+    }
+  }
+  return found;
+}
+
+std::string LazyDocument::getError() const {
+  if (!prelude.error.empty()) {
+    return prelude.error;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (tables[i].ready.load(std::memory_order_acquire) &&
+        !tables[i].error.empty()) {
+      return tables[i].error;
+    }
+  }
+  return "";
+}
+
+const Document* LazyDocument::materialize(Table& table) const {
+  std::call_once(table.once, [&] {
+    parseInto(table);
+    ++parsed;
+  });
+  return table.document.get();
+}
+
+void LazyDocument::parseInto(Table& table) const {
+  std::string_view text = source->view();
+  Parser parser(Parser::Section(),
+                text.substr(table.begin, table.end - table.begin));
+  if (parser.parsed) {
+    table.document = parser.document;
+  } else {
+    table.error = parser.getError();
+  }
+  table.ready.store(true, std::memory_order_release);
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "document.hpp"
+#include "source.hpp"
+
+namespace GTOML {
+// A document whose tables are parsed on first use. Opening it only finds the
+// top-level table headers with the lexer's structural scan and parses the
+// keys before the first table. A lookup then parses the one or few tables
+// that can hold its path, so the cost of a process that reads a handful of
+// tables out of a large file depends on those tables, not on the file.
+//
+// Lookups give the same answers as Parser on the whole text, including
+// which definition wins when a path is defined twice. Any number of threads
+// may look up concurrently; a table that several threads need at once is
+// parsed by one of them while the others wait for it.
+//
+// Errors are found only in the parts that have been parsed: a broken table
+// that is never read is never reported. A header left without its ']' makes
+// the scan see the tables after it as part of it, like the eager parse would.
+class LazyDocument {
+ public:
+  explicit LazyDocument(std::shared_ptr<const Source> source);
+  LazyDocument(const LazyDocument&) = delete;
+  LazyDocument& operator=(const LazyDocument&) = delete;
+
+  // Returns the value at `path`, parsing the tables it may live in first.
+  // The pointer stays valid for the life of the LazyDocument.
+  const Value* find(std::string_view path) const;
+
+  template <typename T>
+  std::optional<T> get(std::string_view path) const {
+    const Value* value = find(path);
+    if (!value) {
+      return std::nullopt;
+    }
+    return value->as<T>();
+  }
+
+  size_t tableCount() const { return count; }
+  // Tables parsed so far.
+  size_t parsedCount() const { return parsed.load(); }
+  // The first error, in source order, of the parts parsed so far, or "".
+  std::string getError() const;
+
+ private:
+  struct Table {
+    size_t begin = 0;  // the '[' of the header
+    size_t end = 0;
+    size_t next = SIZE_MAX;  // the next table with the same name
+    std::once_flag once;
+    std::atomic<bool> ready{false};
+    std::shared_ptr<const Document> document;
+    std::string error;
+  };
+
+  const Document* materialize(Table& table) const;
+  void parseInto(Table& table) const;
+
+  std::shared_ptr<const Source> source;
+  Table prelude;  // the keys before the first header
+  std::unique_ptr<Table[]> tables;
+  size_t count = 0;
+  // First and last table of each header name.
+  std::unordered_map<std::string_view, std::pair<size_t, size_t>> byName;
+  mutable std::atomic<size_t> parsed{0};
+};
+}  // namespace GTOML
@@ -1,213 +1,210 @@
 #include "lexer.hpp"
 
+#include <cctype>
+
+#include "scanner.hpp"
+
 using namespace GTOML;
 
 void Lexer::lex() {
-  bool insideBrackets = false;
-  bool insideComment = false;
-  bool insideString = false;
-  std::string currentTokenValue;
-
-  auto pushToken = [&]() {
-    if (!currentTokenValue.empty()) {
-      Token tokenType = classify_token(
-          {Token::IDENTIFIER, currentTokenValue});
-      tokens.push_back({tokenType, currentTokenValue});
-      currentTokenValue.clear();
-    }
-  };
+  materialized = true;
+  pos = 0;
+  produced = 0;
+  finished = false;
+  scanner = Scanner(content);
+  tokenTypes.clear();
+  tokenOffsets.clear();
+  tokenLengths.clear();
+
+  while (lexToken()) {
+  }
+}
 
-  for (auto it = content.begin(); it != content.end(); ++it) {
-    char line = *it;
+// Lexes the next token, skipping blanks and comments. Returns false once the
+// EoF token has been produced.
+bool Lexer::lexToken() {
+  if (finished) {
+    return false;
+  }
+  if (content.size() > UINT32_MAX) {
+    std::cerr << "File " << filename << " is larger than 4 GiB" << std::endl;
+    addToken(Token::EoF, 0, 0);
+    finished = true;
+    return false;
+  }
 
-    switch (line) {
-      case '[':
-        if (!insideComment) {
-          if (insideBrackets) {
-            pushToken();
-          }
-          tokens.push_back({Token::LEFT_BRACKET, "["});
-          insideBrackets = true;
-        }
-        break;
-      case ']':
-        if (!insideComment) {
-          pushToken();
-          tokens.push_back({Token::RIGHT_BRACKET, "]"});
-          insideBrackets = false;
-        }
+  const char* data = content.data();
+  const size_t size = content.size();
+
+  while ((pos = scanner.find(pos, Scanner::kNonBlank)) < size) {
+    switch (charClass(data[pos])) {
+      case kLeftBracket:
+        addToken(Token::LEFT_BRACKET, pos++, 1);
+        return true;
+      case kRightBracket:
+        addToken(Token::RIGHT_BRACKET, pos++, 1);
+        return true;
+      case kEqual:
+        addToken(Token::EQUAL, pos++, 1);
+        return true;
+      case kComma:
+        addToken(Token::COMMA, pos++, 1);
+        return true;
+      case kHash:
+        // Comments run to the end of the line.
+        pos = scanner.find(pos, Scanner::kNewline);
         break;
-      case '=':
-        if (!insideComment) {
-          pushToken();
-          tokens.push_back({Token::EQUAL, "="});
+      case kQuote: {
+        // Basic strings keep their quotes and escapes; a string that is not
+        // closed before the end of the line is left as an IDENTIFIER so the
+        // parser reports it.
+        size_t start = pos++;
+        Token type = Token::IDENTIFIER;
+        while ((pos = scanner.find(pos, Scanner::kStringEnd)) < size &&
+               data[pos] != '\n') {
+          if (data[pos] == '\\') {
+            pos += 2;
+            continue;
+          }
+          ++pos;
+          type = Token::STRING;
+          break;
         }
+        pos = std::min(pos, size);
+        addToken(type, start, pos - start);
+        return true;
+      }
+      default: {
+        size_t start = pos;
+        pos = scanner.find(pos, Scanner::kSpecial);
+        std::string_view value = content.substr(start, pos - start);
+        addToken(classify_token({Token::IDENTIFIER, value}), start,
+                 value.size());
+        return true;
+      }
+    }
+  }
+
+  addToken(Token::EoF, size, 0);
+  finished = true;
+  return false;
+}
+
+std::vector<size_t> Lexer::findTableHeaders(std::string_view content) {
+  std::vector<size_t> headers;
+  Scanner scanner(content);
+  const char* data = content.data();
+  const size_t size = content.size();
+  int depth = 0;
+
+  size_t pos = 0;
+  while ((pos = scanner.find(pos, Scanner::kStructure)) < size) {
+    switch (charClass(data[pos])) {
+      case kHash:
+        pos = scanner.find(pos, Scanner::kNewline);
         break;
-      case ',':
-        if (!insideComment) {
-          pushToken();
-          tokens.push_back({Token::COMMA, ","});
-        }
-      case '\n':
-      case '\t':
-      case '\r':
-      case ' ':
-        if (!insideComment) {
-          pushToken();
+      case kQuote:
+        // Mirrors lexToken(): escapes skip a byte, and an unterminated
+        // string stops at the end of the line.
+        ++pos;
+        while ((pos = scanner.find(pos, Scanner::kStringEnd)) < size &&
+               data[pos] != '\n') {
+          if (data[pos] == '\\') {
+            pos += 2;
+            continue;
+          }
+          ++pos;
+          break;
         }
         break;
-      case '"':
-        if (!insideComment && insideBrackets) {
-          if (insideString) {
-            pushToken();
+      case kEqual:
+        // The value follows past blanks, newlines and comments, as in
+        // lexToken(); if it is an array, its '[' is not a header.
+        ++pos;
+        if (depth == 0) {
+          while ((pos = scanner.find(pos, Scanner::kNonBlank)) < size &&
+                 data[pos] == '#') {
+            pos = scanner.find(pos, Scanner::kNewline);
+          }
+          if (pos < size && data[pos] == '[') {
+            ++depth;
+            ++pos;
           }
-          insideString = !insideString;
         }
-        currentTokenValue += line;
-        break;
-      case '#':
-        insideComment = true;
         break;
-      case '\0':
-        pushToken();
-        tokens.push_back({Token::EoF, "\0"});
+      case kLeftBracket:
+        if (depth == 0) {
+          headers.push_back(pos);
+        }
+        ++depth;
+        ++pos;
         break;
-      default:
-        if (!insideComment) {
-          currentTokenValue += line;
+      default:  // kRightBracket
+        if (--depth < 0) {
+          return {};
         }
+        ++pos;
         break;
     }
-
-    if (line == '\n' && insideComment) {
-      insideComment = false;
-    }
   }
-
-  pushToken();  // Push the last token
+  return headers;
 }
 
+// Classifies a single token's text. lex() calls it once for every bare
+// token; punctuation and strings are typed directly from the character table.
 Token Lexer::classify_token(const SToken& token) {
-  const std::string& value = token.value;
-  if (value == "[") {
-    return Token::LEFT_BRACKET;
-  } else if (value == "]") {
-    return Token::RIGHT_BRACKET;
-  } else if (value == ".") {
-    return Token::DOT;
-  } else if (value == "=") {
-    return Token::EQUAL;
-  } else if (value == "true" || value == "false") {
-    return Token::BOOL;
-  } else if (is_number(value)) {
-    bool isFloat = (value.find('.') != std::string::npos);
-    if (value[0] == '+' || value[0] == '-') {
-      if (value.size() > 1 &&
-          (isdigit(value[1]) || (isFloat && isdigit(value[1])))) {
-        return isFloat ? Token::FLOAT : Token::NUMBER;
-      } else {
-        return Token::IDENTIFIER;
-      }
-    } else {
-      return Token::IDENTIFIER;
-    }
-  } else if (is_string(value)) {
-    return Token::STRING;
-  } else if (value == "\0") {
+  std::string_view value = token.value;
+  if (value.empty()) {
     return Token::EoF;
-  } else {
-    if (std::all_of(value.begin(), value.end(),
-                    [](char c) { return isalnum(c) || c == '_'; })) {
-      return Token::IDENTIFIER;
+  }
+  if (value.size() == 1) {
+    switch (charClass(value[0])) {
+      case kLeftBracket:
+        return Token::LEFT_BRACKET;
+      case kRightBracket:
+        return Token::RIGHT_BRACKET;
+      case kEqual:
+        return Token::EQUAL;
+      case kComma:
+        return Token::COMMA;
+      default:
+        if (value[0] == '.') {
+          return Token::DOT;
+        }
+        break;
     }
-    return Token::IDENTIFIER;
   }
-}
-
-bool Lexer::is_number(const std::string& str) {
-  if (str.empty()) {
-    return false;
+  if (value.front() == '"') {
+    return value.size() > 1 && value.back() == '"' ? Token::STRING
+                                                   : Token::IDENTIFIER;
   }
-
-  size_t start = 0;
-  if (str[0] == '+' || str[0] == '-') {
-    start = 1;
+  if (value == "true" || value == "false") {
+    return Token::BOOL;
   }
 
-  size_t numUnderscores = 0;
-
-  for (size_t i = start; i < str.length(); ++i) {
-    if (str[i] == '_') {
-      numUnderscores++;
-      continue;
-    }
-    if (!isdigit(str[i])) {
-      return false;
-    }
+  size_t digit = (value[0] == '+' || value[0] == '-') ? 1 : 0;
+  std::string_view unsigned_value = value.substr(digit);
+  if (unsigned_value == "inf" || unsigned_value == "nan") {
+    return Token::FLOAT;
   }
-
-  if (numUnderscores > 0) {
-    for (size_t i = start; i < str.length(); ++i) {
-      if (str[i] == '_') {
-        if (i == start || i == str.length() - 1 || str[i - 1] == '_') {
-          return false;
-        }
-      }
-    }
+  if (unsigned_value.empty() || !std::isdigit(unsigned_value[0])) {
+    return Token::IDENTIFIER;
   }
-
-  return true;
-}
-
-bool Lexer::is_string(const std::string& str) {
-  return !str.empty() && str.front() == '"' && str.back() == '"';
-}
-
-void Lexer::toknizer() {
-  for (auto& token : tokens) {
-    if (token.value == "[") {
-      token.type = Token::LEFT_BRACKET;
-    } else if (token.value == "]") {
-      token.type = Token::RIGHT_BRACKET;
-    } else if (token.value == ".") {
-      token.type = Token::DOT;
-    } else if (token.value == ",") {
-      token.type = Token::COMMA;
-    } else if (token.value == "=") {
-      token.type = Token::EQUAL;
-    } else if (std::isdigit(token.value[0]) ||
-               (token.value[0] == '-' && std::isdigit(token.value[1]))) {
-      bool isFloat = false;
-      bool isNumber = true;
-      for (char c : token.value) {
-        if (c == '.') {
-          isFloat = true;
-        } else if (!std::isdigit(c)) {
-          isNumber = false;
-          break;
-        }
-      }
-      token.type = isFloat ? Token::FLOAT : Token::NUMBER;
-    } else if (token.value[0] == '"' &&
-               token.value[token.value.length() - 1] == '"') {
-      token.type = Token::STRING;
-    } else if (token.value[0] == '"') {
-      token.type = Token::STRING;
-    } else if (token.value == "false" || token.value == "true") {
-      token.type = Token::BOOL;
-    } else if (token.value == "\0") {
-      token.type = Token::EoF;
-    } else {
-      token.type = Token::IDENTIFIER;
-    }
+  // 0x, 0o and 0b integers may contain 'e' as a digit; anything else with a
+  // fraction or an exponent is a float. parseValue() validates the digits.
+  if (digit == 0 && value.size() > 1 && value[0] == '0' &&
+      (value[1] == 'x' || value[1] == 'o' || value[1] == 'b')) {
+    return Token::NUMBER;
   }
+  return value.find_first_of(".eE") != std::string_view::npos ? Token::FLOAT
+                                                              : Token::NUMBER;
 }
 
 void Lexer::print_tokens_type() {
-  for (const auto& token : tokens) {
+  for (Token type : tokenTypes) {
     std::string tokenTypeStr;
 
-    switch (token.type) {
+    switch (type) {
       case Token::LEFT_BRACKET:
         tokenTypeStr = "LEFT_BRACKET";
         break;
@@ -251,21 +248,28 @@ void Lexer::print_tokens_type() {
 }
 
 
-void Lexer::read() {
-  std::fstream file(filename.data(), std::ios::in | std::ios::binary);
+bool Lexer::read() {
+  source = Source::read(filename);
 
-  if (file.is_open()) {
-    file.seekg(0, std::ios::end);
-    content.resize(file.tellg());
-    file.seekg(0, std::ios::beg);
-    file.read(&content[0], content.size());
-    file.close();
+  if (source) {
+    content = source->view();
+    scanner = Scanner(content);
+    return true;
+  }
+  std::cerr << "File " << filename << " not found" << std::endl;
+  return false;
+}
 
-    content.push_back('\0');
-  } else {
-    std::cout << "File " << filename << " not found" << std::endl;
-    exit(1);
+bool Lexer::map() {
+  source = Source::map(filename);
+
+  if (source) {
+    content = source->view();
+    scanner = Scanner(content);
+    return true;
   }
+  std::cerr << "File " << filename << " not found" << std::endl;
+  return false;
 }
 
 void Lexer::print_file() {
@@ -275,25 +279,57 @@ void Lexer::print_file() {
   std::cout << std::endl;
 }
 
+void Lexer::addToken(Token type, size_t offset, size_t length) {
+  if (materialized) {
+    tokenTypes.push_back(type);
+    tokenOffsets.push_back(static_cast<uint32_t>(offset));
+    tokenLengths.push_back(static_cast<uint32_t>(length));
+  } else {
+    size_t slot = produced % kWindow;
+    windowTypes[slot] = type;
+    windowOffsets[slot] = static_cast<uint32_t>(offset);
+    windowLengths[slot] = static_cast<uint32_t>(length);
+  }
+  ++produced;
+}
+
+// Lexes ahead until the token at `index` exists. Returns false if the input
+// ends first.
+bool Lexer::ensureToken(size_t index) {
+  while (produced <= index && lexToken()) {
+  }
+  return index < produced;
+}
+
+SToken Lexer::tokenAt(size_t index) {
+  if (materialized) {
+    return {tokenTypes[index],
+            content.substr(tokenOffsets[index], tokenLengths[index])};
+  }
+  size_t slot = index % kWindow;
+  return {windowTypes[slot],
+          content.substr(windowOffsets[slot], windowLengths[slot])};
+}
+
 SToken Lexer::NextToken() {
-  if (currentTokenIndex < tokens.size()) {
-    return tokens[currentTokenIndex++];
+  if (ensureToken(currentTokenIndex)) {
+    return tokenAt(currentTokenIndex++);
   } else {
     return CreateEofToken();  // Return an EOF token if there are no more tokens
   }
 }
 
 SToken Lexer::GetCurrentToken() {
-  if (currentTokenIndex < tokens.size()) {
-    return tokens[currentTokenIndex];
+  if (ensureToken(currentTokenIndex)) {
+    return tokenAt(currentTokenIndex);
   } else {
     return CreateEofToken();  // Return an EOF token if there are no more tokens
   }
 }
 
 SToken Lexer::PrevToken() {
-  if (currentTokenIndex > 0 && currentTokenIndex <= tokens.size()) {
-    return tokens[currentTokenIndex - 1];
+  if (currentTokenIndex > 0 && currentTokenIndex <= produced) {
+    return tokenAt(currentTokenIndex - 1);
   } else {
     return CreateEmptyToken();  // Return an empty token if there is no previous
                                 // token
@@ -301,15 +337,15 @@ SToken Lexer::PrevToken() {
 }
 
 SToken Lexer::PervPrevToken() {
-  if (currentTokenIndex > 0 && currentTokenIndex <= tokens.size()) {
-    return tokens[currentTokenIndex - 2];
+  if (currentTokenIndex > 1 && currentTokenIndex <= produced) {
+    return tokenAt(currentTokenIndex - 2);
   } else {
     return CreateEmptyToken();  // Return an empty token if there is no previous
                                 // token
   }
 }
 
-bool Lexer::hasMoreTokens() { return currentTokenIndex < tokens.size(); }
+bool Lexer::hasMoreTokens() { return ensureToken(currentTokenIndex); }
 
 SToken Lexer::CreateEofToken() {
   SToken eofToken;
@@ -318,7 +354,7 @@ SToken Lexer::CreateEofToken() {
 }
 
 SToken Lexer::CreateEmptyToken() {
-  SToken emptyToken;
+  SToken emptyToken{};
   return emptyToken;
 }
 
@@ -347,4 +383,5 @@ std::string Lexer::ToString(Token token) {
     case Token::EoF:
       return "EOF";
   }
+  return "UNKNOWN";
 }
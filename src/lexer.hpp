@@ -1,12 +1,18 @@
 #pragma once
 #include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "scanner.hpp"
+#include "source.hpp"
+
 namespace GTOML {
-enum class Token {
+enum class Token : uint8_t {
   LEFT_BRACKET,
   RIGHT_BRACKET,
   EQUAL,
@@ -22,7 +28,7 @@ enum class Token {
 
 struct SToken {
   Token type;
-  std::string value;
+  std::string_view value;  // points into the Lexer's source
   std::string ToString() {
     switch (type) {
       case Token::LEFT_BRACKET:
@@ -64,7 +70,15 @@ struct SToken {
 
 class Lexer {
  public:
-  Lexer(std::string filename) : filename(filename){};
+  Lexer(std::string filename) : filename(filename), scanner(content){};
+  Lexer(std::shared_ptr<const Source> source)
+      : source(source),
+        content(source ? source->view() : ""),
+        scanner(content) {}
+
+  // Tokens are lexed on demand as the parser advances, and only a small
+  // window of them is kept, so memory does not grow with the token count.
+  // Calling lex() instead materializes every token up front.
   size_t currentTokenIndex = 0;
 
   SToken NextToken();
@@ -72,28 +86,58 @@ class Lexer {
   SToken PrevToken();
   SToken PervPrevToken();
 
-  void read();
+  bool read();
+  bool map();
   void print_file();
-  void toknizer();
   void lex();
   void print_tokens();
   void print_tokens_type();
 
-  Token classify_token(const SToken& token);
-  bool is_number(const std::string& str);
-  bool is_string(const std::string& str);
+  static Token classify_token(const SToken& token);
   bool hasMoreTokens();
+  size_t tokenCount() { return produced; }
   SToken CreateEmptyToken();
   SToken CreateEofToken();
 
   std::string getFilePath() { return filename; }
+  bool hasSource() { return source != nullptr; }
+  std::shared_ptr<const Source> getSource() { return source; }
   std::string ToString(Token token);
 
+  // Offsets of the '[' of every top-level table header, found with a quick
+  // scan that skips strings and comments exactly as the lexer does and
+  // tracks array nesting. Returns no offsets if the brackets do not balance.
+  // A '[' that is the next token after an '=' starts an array, not a header.
+  static std::vector<size_t> findTableHeaders(std::string_view content);
+
  private:
   std::string filename;
-  std::string content;
-  std::vector<SToken> tokens;
-  SToken currentToken;
+  std::shared_ptr<const Source> source;
+  std::string_view content;
+
+  Scanner scanner;
+  size_t pos = 0;        // next byte to lex
+  size_t produced = 0;   // tokens lexed so far, including EoF
+  bool finished = false; // the EoF token has been produced
+  bool materialized = false;
+
+  // Tokens are stored as parallel arrays of type, offset and length into
+  // `content`, so lexing allocates nothing per token and the accessors hand
+  // out views. Sources are therefore limited to 4 GiB.
   std::vector<Token> tokenTypes;
+  std::vector<uint32_t> tokenOffsets;
+  std::vector<uint32_t> tokenLengths;
+
+  // While streaming, token i lives in slot i % kWindow. The parser looks
+  // back two tokens (PervPrevToken) and at the current one.
+  static constexpr size_t kWindow = 4;
+  Token windowTypes[kWindow];
+  uint32_t windowOffsets[kWindow];
+  uint32_t windowLengths[kWindow];
+
+  bool lexToken();
+  bool ensureToken(size_t index);
+  void addToken(Token type, size_t offset, size_t length);
+  SToken tokenAt(size_t index);
 };
 }  // namespace GTOML
@@ -0,0 +1,260 @@
+#include "numbers.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace GTOML;
+
+namespace {
+// Copies `text` into `buffer` without underscores, checking that every
+// underscore sits between two digits. Numbers are short, so a fixed stack
+// buffer is enough; anything longer is rejected.
+bool stripUnderscores(std::string_view text, bool hexDigits, char* buffer,
+                      size_t capacity, size_t& size) {
+  auto isDigit = [hexDigits](char c) {
+    return (c >= '0' && c <= '9') ||
+           (hexDigits && ((c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')));
+  };
+
+  size = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] == '_') {
+      if (i == 0 || i + 1 == text.size() || !isDigit(text[i - 1]) ||
+          !isDigit(text[i + 1])) {
+        return false;
+      }
+      continue;
+    }
+    if (size == capacity) {
+      return false;
+    }
+    buffer[size++] = text[i];
+  }
+  return true;
+}
+
+bool isDecimalDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Skips the digits at `i`, returning how many there were.
+size_t skipDigits(std::string_view text, size_t& i) {
+  size_t start = i;
+  while (i < text.size() && isDecimalDigit(text[i])) {
+    ++i;
+  }
+  return i - start;
+}
+
+// Whether `text`, without underscores, is a decimal integer TOML allows:
+// an optional sign, then digits without a leading zero unless the number
+// is 0 itself. from_chars alone would take "007".
+bool isDecimalInteger(std::string_view text) {
+  size_t i = !text.empty() && (text[0] == '+' || text[0] == '-') ? 1 : 0;
+  size_t first = i;
+  size_t digits = skipDigits(text, i);
+  return i == text.size() && digits > 0 &&
+         (digits == 1 || text[first] != '0');
+}
+
+// Whether `text`, without underscores, is a float TOML allows: a decimal
+// integer part, then a fraction with at least one digit, an exponent, or
+// both. from_chars alone would take "1." and "1.e3".
+bool isDecimalFloat(std::string_view text) {
+  size_t i = !text.empty() && (text[0] == '+' || text[0] == '-') ? 1 : 0;
+  size_t first = i;
+  size_t digits = skipDigits(text, i);
+  if (digits == 0 || (digits > 1 && text[first] == '0')) {
+    return false;
+  }
+  bool fraction = i < text.size() && text[i] == '.';
+  if (fraction && skipDigits(text, ++i) == 0) {
+    return false;
+  }
+  bool exponent = i < text.size() && (text[i] == 'e' || text[i] == 'E');
+  if (exponent) {
+    ++i;
+    if (i < text.size() && (text[i] == '+' || text[i] == '-')) {
+      ++i;
+    }
+    if (skipDigits(text, i) == 0) {
+      return false;
+    }
+  }
+  return i == text.size() && (fraction || exponent);
+}
+
+template <typename T, typename... Args>
+bool fromChars(std::string_view text, T& value, Args... args) {
+  const char* end = text.data() + text.size();
+  auto result = std::from_chars(text.data(), end, value, args...);
+  return result.ec == std::errc() && result.ptr == end;
+}
+}  // namespace
+
+bool GTOML::parseInteger(std::string_view text, int64_t& value) {
+  int base = 10;
+  if (text.size() > 2 && text[0] == '0' &&
+      (text[1] == 'x' || text[1] == 'o' || text[1] == 'b')) {
+    base = text[1] == 'x' ? 16 : text[1] == 'o' ? 8 : 2;
+    text.remove_prefix(2);
+  } else if (!text.empty() && text[0] == '+') {
+    text.remove_prefix(1);
+    if (!text.empty() && text[0] == '-') {
+      return false;
+    }
+  }
+  if (text.empty() || text[0] == '+' || (base != 10 && text[0] == '-')) {
+    return false;
+  }
+
+  if (text.find('_') == std::string_view::npos) {
+    return (base != 10 || isDecimalInteger(text)) &&
+           fromChars(text, value, base);
+  }
+
+  char digits[80];
+  size_t size;
+  if (!stripUnderscores(text, base == 16, digits, sizeof(digits), size)) {
+    return false;
+  }
+  std::string_view compact(digits, size);
+  return (base != 10 || isDecimalInteger(compact)) &&
+         fromChars(compact, value, base);
+}
+
+bool GTOML::parseFloat(std::string_view text, double& value) {
+  bool negative = !text.empty() && text[0] == '-';
+  std::string_view unsigned_text = text;
+  if (!text.empty() && (text[0] == '+' || text[0] == '-')) {
+    unsigned_text.remove_prefix(1);
+  }
+  if (unsigned_text == "inf") {
+    value = negative ? -std::numeric_limits<double>::infinity()
+                     : std::numeric_limits<double>::infinity();
+    return true;
+  }
+  if (unsigned_text == "nan") {
+    value = negative ? -std::numeric_limits<double>::quiet_NaN()
+                     : std::numeric_limits<double>::quiet_NaN();
+    return true;
+  }
+  if (unsigned_text.empty() || unsigned_text[0] == '+' ||
+      unsigned_text[0] == '-') {
+    return false;
+  }
+  if (text[0] == '+') {
+    text.remove_prefix(1);
+  }
+
+  if (text.find('_') == std::string_view::npos) {
+    return isDecimalFloat(text) && fromChars(text, value);
+  }
+
+  char digits[128];
+  size_t size;
+  if (!stripUnderscores(text, false, digits, sizeof(digits), size)) {
+    return false;
+  }
+  std::string_view compact(digits, size);
+  return isDecimalFloat(compact) && fromChars(compact, value);
+}
+
+bool GTOML::parseString(std::string_view text, std::string& out) {
+  out.clear();
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] != '\\') {
+      out += text[i];
+      continue;
+    }
+    if (++i == text.size()) {
+      return false;
+    }
+    switch (text[i]) {
+      case 'b':
+        out += '\b';
+        continue;
+      case 't':
+        out += '\t';
+        continue;
+      case 'n':
+        out += '\n';
+        continue;
+      case 'f':
+        out += '\f';
+        continue;
+      case 'r':
+        out += '\r';
+        continue;
+      case '"':
+        out += '"';
+        continue;
+      case '\\':
+        out += '\\';
+        continue;
+      case 'u':
+      case 'U':
+        break;
+      default:
+        return false;
+    }
+    size_t digits = text[i] == 'u' ? 4 : 8;
+    if (text.size() - i - 1 < digits) {
+      return false;
+    }
+    uint32_t code = 0;
+    for (size_t d = 0; d < digits; ++d) {
+      char c = text[++i];
+      int nibble = c >= '0' && c <= '9'   ? c - '0'
+                   : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                   : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                          : -1;
+      if (nibble < 0) {
+        return false;
+      }
+      code = code << 4 | nibble;
+    }
+    if (code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) {
+      return false;
+    }
+    if (code < 0x80) {
+      out += static_cast<char>(code);
+    } else if (code < 0x800) {
+      out += static_cast<char>(0xC0 | code >> 6);
+      out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+      out += static_cast<char>(0xE0 | code >> 12);
+      out += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+      out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+      out += static_cast<char>(0xF0 | code >> 18);
+      out += static_cast<char>(0x80 | (code >> 12 & 0x3F));
+      out += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+      out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+  }
+  return true;
+}
+
+size_t GTOML::formatFloat(double value, char* buffer) {
+  if (std::isnan(value)) {
+    const char* text = std::signbit(value) ? "-nan" : "nan";
+    std::memcpy(buffer, text, std::strlen(text));
+    return std::strlen(text);
+  }
+  if (std::isinf(value)) {
+    const char* text = value < 0 ? "-inf" : "inf";
+    std::memcpy(buffer, text, std::strlen(text));
+    return std::strlen(text);
+  }
+
+  char* end = std::to_chars(buffer, buffer + kMaxFloatChars - 2, value).ptr;
+  if (std::find_if(buffer, end, [](char c) {
+        return c == '.' || c == 'e' || c == 'E';
+      }) == end) {
+    *end++ = '.';
+    *end++ = '0';
+  }
+  return end - buffer;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace GTOML {
+// Parses a TOML integer: decimal with an optional sign and no leading
+// zeros, or 0x / 0o / 0b prefixed, with single underscores allowed between
+// digits. Returns false if the text is not a valid integer or does not fit
+// in 64 bits.
+bool parseInteger(std::string_view text, int64_t& value);
+
+// Parses a TOML float, including exponents, underscores, inf and nan. The
+// integer part has no leading zeros and a '.' needs digits on both sides.
+bool parseFloat(std::string_view text, double& value);
+
+// Decodes the escapes of a basic string, given without its quotes, into
+// `out`: \b \t \n \f \r \" \\ and \uXXXX or \UXXXXXXXX as UTF-8.
+// Returns false on any other escape or a code point that is not a Unicode
+// scalar value.
+bool parseString(std::string_view text, std::string& out);
+
+// Writes the shortest text that reads back as `value`, always in TOML float
+// form ("1.0", "inf", "-nan"). `buffer` needs kMaxFloatChars bytes; returns
+// the number of characters written.
+constexpr size_t kMaxFloatChars = 32;
+size_t formatFloat(double value, char* buffer);
+}  // namespace GTOML
@@ -1,447 +1,727 @@
 #include "parser.hpp"
 
-using namespace GTOML;
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_set>
 
-bool Parser::Parse() {
-  Token currentTokenType = lexer.GetCurrentToken().type;
+using namespace GTOML;
 
-  while (currentTokenType != Token::EoF) {
-    if (currentTokenType == Token::IDENTIFIER) {
-      parseKey();
-    } else if (currentTokenType == Token::LEFT_BRACKET) {
-      parseTable();
-    } else {
-      std::cerr << "Unexpected token: " << lexer.ToString(currentTokenType)
-                << std::endl;
-      return false;
-    }
-    currentTokenType = lexer.GetCurrentToken().type;
-  }
-  return true;
+namespace {
+std::string floatToString(double value) {
+  char buffer[kMaxFloatChars];
+  return std::string(buffer, formatFloat(value, buffer));
 }
 
-bool Parser::expect(Token token) {
-  Token currentToken = lexer.GetCurrentToken().type;
-  if (currentToken != token) {
-    std::cerr << "Expected " << lexer.ToString(token) << " but got "
-              << lexer.ToString(currentToken) << std::endl;
-    return false;
+// Scalars as getValueByKey() and getTableValue() report them.
+std::string scalarToString(const Value& value) {
+  switch (value.kind()) {
+    case Kind::String:
+      return std::string(value.asString());
+    case Kind::Integer:
+      return std::to_string(value.asInteger());
+    case Kind::Float:
+      return floatToString(value.asFloat());
+    case Kind::Bool:
+      return value.asBool() ? "true" : "false";
+    default:
+      return "";
   }
-  return true;
 }
 
-void Parser::consume() {
-  if (lexer.hasMoreTokens()) {
-    lexer.currentTokenIndex++;
+// `value` and everything in it.
+uint64_t countNodes(const Value& value) {
+  uint64_t nodes = 1;
+  if (value.kind() == Kind::Array) {
+    for (const auto& item : value.asArray()) {
+      nodes += countNodes(item);
+    }
+  } else if (value.kind() == Kind::Table) {
+    for (const auto& entry : value.asTable()) {
+      nodes += countNodes(entry.value);
+    }
   }
+  return nodes;
 }
+}  // namespace
 
-std::shared_ptr<TOMLNode> Parser::parseKey() {
-  expect(Token::IDENTIFIER);
-  std::string key = lexer.GetCurrentToken().value;
-  consume();
-  expect(Token::EQUAL);
-  consume();
+Parser::Parser(Section, std::string_view text, Stats* stats)
+    : lexer(Source::borrow(text)), quiet(true), stats(stats),
+      phase("section") {
+  Parse();
+}
 
-  std::shared_ptr<TOMLNode> keyValueNode;
+std::shared_ptr<const Document> GTOML::parse(
+    std::shared_ptr<const Source> source, std::string* error,
+    unsigned threads, Stats* stats) {
+  if (!source) {
+    if (error) {
+      *error = "No source to parse";
+    }
+    return nullptr;
+  }
+  Parser parser(std::move(source), threads, stats);
+  if (error) {
+    *error = parser.getError();
+  }
+  return parser.snapshot();
+}
 
-  if (lexer.GetCurrentToken().type == Token::LEFT_BRACKET) {
-      keyValueNode = parseArray();
-  } else {
-      if (keyValueNode->inside_table){
-          return nullptr;
-      }
-    Token currentToken = lexer.GetCurrentToken().type;
+bool GTOML::parseEvents(std::shared_ptr<const Source> source,
+                        Handler& handler, std::string* error) {
+  if (!source) {
+    if (error) {
+      *error = "No source to parse";
+    }
+    return false;
+  }
+  Parser parser{Parser::Worker()};
+  parser.lexer = Lexer(std::move(source));
+  bool parsed = parser.parseDocument(handler);
+  if (error) {
+    *error = parser.getError();
+  }
+  return parsed;
+}
 
-    if (currentToken == Token::STRING) {
-      std::string value = lexer.GetCurrentToken().value;
-      value = value.substr(1, value.size() - 2);
-      consume();
-      keyValueNode = std::make_shared<KeyValueNode>(
-          key, std::make_shared<StringNode>(value));
-    } else if (currentToken == Token::NUMBER) {
-      int intValue = std::stoi(lexer.GetCurrentToken().value);
-      consume();
-      keyValueNode = std::make_shared<KeyValueNode>(
-          key, std::make_shared<IntegerNode>(intValue));
-    } else if (currentToken == Token::FLOAT) {
-      double floatValue = std::stod(lexer.GetCurrentToken().value);
-      consume();
+// Assembles the document from the grammar's events. Keys and strings are
+// interned as they arrive; array items and table entries gather in the
+// parser's scratch buffers and are copied into the arena when their array
+// or table ends.
+class Parser::Builder {
+ public:
+  explicit Builder(Parser& parser)
+      : parser(parser), document(*parser.document) {}
+
+  bool onTableBegin(std::string_view name) {
+    table = parser.intern(name);
+    tableMark = parser.entryScratch.size();
+    inTable = true;
+    return true;
+  }
+  bool onTableEnd() {
+    Value value = Value::table(parser.collect(parser.entryScratch, tableMark));
+    document.index.insert(table, value);
+    for (const auto& entry : value.asTable()) {
+      document.index.insert(parser.joinPath(table, entry.key), entry.value);
+    }
+    document.entries.push_back({table, value});
+    inTable = false;
+    return true;
+  }
+  bool onKey(std::string_view name) {
+    key = parser.intern(name);
+    return true;
+  }
+  bool onScalar(const Value& value) {
+    if (value.kind() == Kind::String) {
+      return add(Value::string(parser.intern(value.asString())));
+    }
+    return add(value);
+  }
+  bool onArrayBegin() {
+    arrayMarks.push_back(parser.valueScratch.size());
+    return true;
+  }
+  bool onArrayEnd() {
+    size_t mark = arrayMarks.back();
+    arrayMarks.pop_back();
+    return add(Value::array(parser.collect(parser.valueScratch, mark)));
+  }
 
-      std::ostringstream stream;
-      stream << std::fixed << std::setprecision(1) << floatValue;
-      keyValueNode = std::make_shared<KeyValueNode>(
-          key, std::make_shared<FloatNode>(stream.str()));
-    } else if (currentToken == Token::BOOL) {
-      bool boolValue;
-      if (lexer.GetCurrentToken().value == "true") {
-        boolValue = true;
-      } else {
-        boolValue = false;
-      }
-      consume();
-      keyValueNode = std::make_shared<KeyValueNode>(
-          key, std::make_shared<BoolNode>(boolValue));
+ private:
+  // Adds a complete value to the array, table or root it belongs to.
+  bool add(Value value) {
+    if (!arrayMarks.empty()) {
+      parser.valueScratch.push_back(value);
+    } else if (inTable) {
+      parser.entryScratch.push_back({key, value});
     } else {
-      std::cerr << "Unexpected token: " << lexer.ToString(currentToken)
-                << std::endl;
-      return nullptr;
+      document.entries.push_back({key, value});
+      document.index.insert(key, value);
     }
-  }
-  if (!keyValueNode->inside_table) {
-    parsedNodes.push_back(keyValueNode);
+    return true;
   }
 
-  return keyValueNode;
+  Parser& parser;
+  Document& document;
+  std::string_view table;
+  std::string_view key;
+  size_t tableMark = 0;
+  bool inTable = false;
+  std::vector<size_t> arrayMarks;  // where each open array's items start
+};
+
+bool Parser::Parse() {
+  if (parsed) {
+    return true;
+  }
+  if (!lexer.hasSource()) {
+    return false;
+  }
+  if (!stats) {
+    return build();
+  }
+  if (stats->splitLexing && lexer.currentTokenIndex == 0) {
+    Stats::Scope lexing(stats, "lex");
+    lexer.lex();
+    lexing.end();
+    lexing.tokens = lexer.tokenCount();
+    lexing.items = lexer.getSource()->view().size();
+  }
+  Stats::Scope scope(stats, phase);
+  uint64_t tokens = lexer.tokenCount();
+  size_t bytes = document->memoryBytes();
+  bool built = build();
+  scope.end();
+  tally(scope, lexer.tokenCount() - tokens, bytes);
+  return built;
 }
 
+bool Parser::build() {
+  Builder builder(*this);
+  if (!parseDocument(builder)) {
+    entryScratch.clear();
+    valueScratch.clear();
+    return false;
+  }
+  parsed = true;
+  return true;
+}
 
-std::shared_ptr<TOMLNode> Parser::parseTable() {
-    expect(Token::LEFT_BRACKET);
-    consume();
+void Parser::tally(Stats::Scope& scope, uint64_t tokens, size_t bytes) {
+  scope.tokens = tokens;
+  scope.bytes = document->memoryBytes() - bytes;
+  scope.items = lexer.getSource()->view().size();
+  for (const auto& entry : document->entries) {
+    scope.nodes += countNodes(entry.value);
+  }
+}
 
-    expect(Token::IDENTIFIER);
-    std::string tableName = lexer.GetCurrentToken().value;
-    consume();
+bool Parser::parseParallel(unsigned threads) {
+  if (threads < 2 || parsed || !lexer.hasSource() ||
+      lexer.currentTokenIndex != 0) {
+    return Parse();
+  }
 
-    expect(Token::RIGHT_BRACKET);
-    consume();
+  // Group consecutive tables into a few sections per thread so that each
+  // section is large enough to be worth a Parser of its own.
+  std::string_view text = lexer.getSource()->view();
+  size_t target = text.size() / (threads * 4) + 1;
+  std::vector<size_t> cuts{0};
+  for (size_t header : Lexer::findTableHeaders(text)) {
+    if (header - cuts.back() >= target) {
+      cuts.push_back(header);
+    }
+  }
+  cuts.push_back(text.size());
+  size_t count = cuts.size() - 1;
+  if (count < 2) {
+    return Parse();
+  }
 
-    std::vector<std::shared_ptr<TOMLNode>> entries;
-    std::shared_ptr<TableNode> tableNode = std::make_shared<TableNode>(entries);
-    tableNode->name = tableName;
+  Stats::Scope scope(stats, "parse");
+  std::vector<std::unique_ptr<Parser>> sections(count);
+  std::atomic<size_t> next{0};
+  auto work = [&] {
+    for (size_t i; (i = next++) < count;) {
+      sections[i].reset(new Parser(
+          Section(), text.substr(cuts[i], cuts[i + 1] - cuts[i]), stats));
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < std::min<size_t>(threads, count); ++i) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto& worker : workers) {
+    worker.join();
+  }
 
-    Token currentToken = lexer.GetCurrentToken().type;
-    while (currentToken == Token::IDENTIFIER) {
-        std::shared_ptr<TOMLNode> keyValueNode;
+  for (const auto& section : sections) {
+    if (!section->parsed) {
+      bool built = build();
+      if (scope.enabled()) {
+        scope.end();
+        tally(scope, lexer.tokenCount(), 0);
+      }
+      return built;
+    }
+  }
+  Stats::Scope merging(stats, "merge");
+  for (const auto& section : sections) {
+    Document& part = *section->document;
+    document->arena.adopt(std::move(part.arena));
+    document->entries.insert(document->entries.end(), part.entries.begin(),
+                             part.entries.end());
+    document->strings.merge(part.strings);
+    document->index.merge(part.index);
+  }
+  parsed = true;
+  merging.end();
+  merging.items = count;
+  if (scope.enabled()) {
+    scope.end();
+    uint64_t tokens = 0;
+    for (const auto& section : sections) {
+      tokens += section->lexer.tokenCount();
+    }
+    tally(scope, tokens, 0);
+  }
+  return true;
+}
 
-        if (currentToken == Token::IDENTIFIER) {
-            keyValueNode = parseTableKey();
-        } else if (currentToken == Token::LEFT_BRACKET) {
-            keyValueNode = parseTableArray();
-        }
+bool Parser::reparse(std::shared_ptr<const Source> source) {
+  lexer = Lexer(source);
+  document = std::make_shared<Document>();
+  error.clear();
+  parsed = false;
+  entryScratch.clear();
+  valueScratch.clear();
+  extents.clear();
+  return Parse();
+}
 
-        if (keyValueNode) {
-            tableNode->entries.push_back(keyValueNode);
-        } else {
-            return nullptr;
-        }
-        currentToken = lexer.GetCurrentToken().type;
+bool Parser::applyEdit(std::shared_ptr<const Source> edited, size_t offset,
+                       size_t removed, size_t inserted) {
+  Stats::Scope scope(stats, "edit");
+  std::shared_ptr<const Source> previous = lexer.getSource();
+  if (!parsed || !previous || !edited ||
+      offset + removed > previous->view().size() ||
+      edited->view().size() + removed != previous->view().size() + inserted ||
+      document->index.shadowed() != 0 ||
+      (extents.empty() && !buildExtents())) {
+    return reparse(edited);
+  }
+  std::string_view before = previous->view();
+  std::string_view after = edited->view();
+
+  // The sections holding the first and the last byte of the edit. An edit
+  // on a header line may turn the header into something else, and then its
+  // keys belong to the section above.
+  size_t first = extentAt(offset);
+  if (first > 0 && offset <= before.find('\n', extents[first].begin)) {
+    --first;
+  }
+  // The next section must start on a fresh line of the edited text;
+  // otherwise a comment or string that now runs to the end of the line
+  // could swallow its header.
+  size_t last = extentAt(offset + removed);
+  size_t begin = extents[first].begin;
+  size_t end = before.size();
+  for (; last + 1 < extents.size(); ++last) {
+    end = extents[last + 1].begin;
+    size_t next = end + inserted - removed;
+    if (after[next - 1] == '\n' && (next < 2 || after[next - 2] != '\\')) {
+      break;
     }
+    end = before.size();
+  }
+  size_t firstEntry = extents[first].firstEntry;
+  size_t endEntry = last + 1 < extents.size() ? extents[last + 1].firstEntry
+                                              : document->entries.size();
+  std::string_view text = after.substr(begin, end + inserted - removed - begin);
+
+  Parser section(Section(), text, stats);
+  std::vector<size_t> headers = Lexer::findTableHeaders(text);
+  const std::vector<KeyValue>& fresh = section.document->entries;
+  size_t keys = 0;
+  while (keys < fresh.size() && fresh[keys].value.kind() != Kind::Table) {
+    ++keys;
+  }
+  if (!section.parsed || section.document->index.shadowed() != 0 ||
+      keys + headers.size() != fresh.size() ||
+      (first > 0 && (keys != 0 || headers.empty() || headers[0] != 0))) {
+    return reparse(edited);
+  }
 
-    parsedNodes.push_back(tableNode);
+  // Paths the replaced sections define. The document has no shadowed paths,
+  // so each of them is owned by these sections alone.
+  std::unordered_set<std::string> stale;
+  for (size_t i = firstEntry; i < endEntry; ++i) {
+    const KeyValue& entry = document->entries[i];
+    stale.emplace(entry.key);
+    if (entry.value.kind() == Kind::Table) {
+      for (const auto& child : entry.value.asTable()) {
+        stale.emplace(std::string(entry.key) + "." + std::string(child.key));
+      }
+    }
+  }
+  bool clash = false;
+  section.document->index.forEach([&](std::string_view path, const Value&) {
+    clash = clash ||
+            (document->find(path) && !stale.count(std::string(path)));
+  });
+  if (clash) {
+    return reparse(edited);
+  }
 
-    return tableNode;
+  // A snapshot of the current document may be shared with readers, so edit
+  // a copy. The copy keeps the original alive for the entries it shares.
+  if (document.use_count() > 1) {
+    auto copy = std::make_shared<Document>();
+    copy->entries = document->entries;
+    copy->strings = document->strings;
+    copy->index = document->index;
+    copy->base = document;
+    document = copy;
+  }
+  for (const auto& path : stale) {
+    document->index.erase(path);
+  }
+  Document& part = *section.document;
+  document->arena.adopt(std::move(part.arena));
+  document->strings.merge(part.strings);
+  document->index.merge(part.index);
+  document->entries.erase(document->entries.begin() + firstEntry,
+                          document->entries.begin() + endEntry);
+  document->entries.insert(document->entries.begin() + firstEntry,
+                           part.entries.begin(), part.entries.end());
+  document->generation = Document::nextGeneration();
+
+  std::vector<Extent> spliced;
+  if (first == 0) {
+    spliced.push_back({0, 0});
+  }
+  for (size_t i = 0; i < headers.size(); ++i) {
+    spliced.push_back({begin + headers[i], firstEntry + keys + i});
+  }
+  for (size_t i = last + 1; i < extents.size(); ++i) {
+    extents[i].begin = extents[i].begin + inserted - removed;
+    extents[i].firstEntry =
+        extents[i].firstEntry + part.entries.size() - (endEntry - firstEntry);
+  }
+  extents.erase(extents.begin() + first, extents.begin() + last + 1);
+  extents.insert(extents.begin() + first, spliced.begin(), spliced.end());
+
+  lexer = Lexer(edited);
+  error.clear();
+  scope.end();
+  scope.tokens = section.lexer.tokenCount();
+  scope.items = text.size();
+  return true;
 }
 
-std::shared_ptr<TOMLNode> Parser::parseTableArray() {
-    expect(Token::LEFT_BRACKET);
-    consume();
+// Maps the top-level sections of the parsed source to their entries.
+// Returns false if the headers found by a quick scan do not line up with
+// the parsed tables.
+bool Parser::buildExtents() {
+  std::vector<size_t> headers =
+      Lexer::findTableHeaders(lexer.getSource()->view());
+  const std::vector<KeyValue>& entries = document->entries;
+  size_t keys = 0;
+  while (keys < entries.size() && entries[keys].value.kind() != Kind::Table) {
+    ++keys;
+  }
+  if (keys + headers.size() != entries.size()) {
+    return false;
+  }
 
-    expect(Token::IDENTIFIER);
-    std::string tableName = lexer.GetCurrentToken().value;
-    consume();
+  extents.push_back({0, 0});
+  for (size_t i = 0; i < headers.size(); ++i) {
+    extents.push_back({headers[i], keys + i});
+  }
+  return true;
+}
 
-    expect(Token::RIGHT_BRACKET);
-    consume();
+// The section that holds the byte at `offset`.
+size_t Parser::extentAt(size_t offset) const {
+  auto next = std::upper_bound(
+      extents.begin(), extents.end(), offset,
+      [](size_t at, const Extent& extent) { return at < extent.begin; });
+  return next - extents.begin() - 1;
+}
 
-    std::vector<std::shared_ptr<TOMLNode>> entries;
+void Parser::fail(const std::string& message) {
+  if (error.empty()) {
+    error = message;
+  }
+  if (!quiet) {
+    std::cerr << message << std::endl;
+  }
+}
 
-    Token currentToken = lexer.GetCurrentToken().type;
-    while (currentToken == Token::LEFT_BRACKET) {
-        std::shared_ptr<TOMLNode> tableNode = parseTable();
-        if (tableNode) {
-            entries.push_back(tableNode);
-        } else {
-            return nullptr;
-        }
-        currentToken = lexer.GetCurrentToken().type;
-    }
+bool Parser::expect(Token token) {
+  Token currentToken = lexer.GetCurrentToken().type;
+  if (currentToken != token) {
+    fail("Expected " + lexer.ToString(token) + " but got " +
+         lexer.ToString(currentToken));
+    return false;
+  }
+  return true;
+}
 
-    std::shared_ptr<ArrayNode> tableArrayNode = std::make_shared<ArrayNode>(tableName, entries);
+void Parser::consume() {
+  if (lexer.hasMoreTokens()) {
+    lexer.currentTokenIndex++;
+  }
+}
 
-    parsedNodes.push_back(tableArrayNode);
+template <typename Sink>
+bool Parser::parseDocument(Sink& sink) {
+  Token currentTokenType = lexer.GetCurrentToken().type;
 
-    return tableArrayNode;
+  while (currentTokenType != Token::EoF) {
+    if (currentTokenType == Token::IDENTIFIER) {
+      if (!parseKey(sink)) {
+        return false;
+      }
+    } else if (currentTokenType == Token::LEFT_BRACKET) {
+      if (!parseTable(sink)) {
+        return false;
+      }
+    } else {
+      fail("Unexpected token: " + lexer.ToString(currentTokenType));
+      return false;
+    }
+    currentTokenType = lexer.GetCurrentToken().type;
+  }
+  return true;
 }
 
-Node Parser::parseTableKey() {
-  expect(Token::IDENTIFIER);
-  std::string key = lexer.GetCurrentToken().value;
+// Parses `key = value`.
+template <typename Sink>
+bool Parser::parseKey(Sink& sink) {
+  if (!expect(Token::IDENTIFIER)) {
+    return false;
+  }
+  std::string_view key = lexer.GetCurrentToken().value;
   consume();
-  expect(Token::EQUAL);
+  if (!expect(Token::EQUAL)) {
+    return false;
+  }
   consume();
 
-  std::shared_ptr<TOMLNode> keyValueNode;
+  return sink.onKey(key) && parseValue(sink);
+}
 
-  if (lexer.GetCurrentToken().type == Token::LEFT_BRACKET) {
-    keyValueNode = parseArray();
-  } else {
-    Token currentToken = lexer.GetCurrentToken().type;
+template <typename Sink>
+bool Parser::parseTable(Sink& sink) {
+  if (!expect(Token::LEFT_BRACKET)) {
+    return false;
+  }
+  consume();
 
-    if (currentToken == Token::STRING) {
-      std::string value = lexer.GetCurrentToken().value;
-      value = value.substr(1, value.size() - 2);
-      consume();
-      keyValueNode = std::make_shared<KeyValueNode>(
-          key, std::make_shared<StringNode>(value));
-    } else if (currentToken == Token::NUMBER) {
-      int intValue = std::stoi(lexer.GetCurrentToken().value);
-      consume();
-      keyValueNode = std::make_shared<KeyValueNode>(
-          key, std::make_shared<IntegerNode>(intValue));
-    } else if (currentToken == Token::FLOAT) {
-      double floatValue = std::stod(lexer.GetCurrentToken().value);
-      consume();
+  if (!expect(Token::IDENTIFIER)) {
+    return false;
+  }
+  std::string_view tableName = lexer.GetCurrentToken().value;
+  consume();
 
-      std::ostringstream stream;
-      stream << std::fixed << std::setprecision(1) << floatValue;
-      keyValueNode = std::make_shared<KeyValueNode>(
-          key, std::make_shared<FloatNode>(stream.str()));
-    } else if (currentToken == Token::BOOL) {
-      bool boolValue;
-      if (lexer.GetCurrentToken().value == "true") {
-        boolValue = true;
-      } else {
-        boolValue = false;
-      }
-      consume();
-      keyValueNode = std::make_shared<KeyValueNode>(
-          key, std::make_shared<BoolNode>(boolValue));
-    } else {
-      std::cerr << "Unexpected token: " << lexer.ToString(currentToken)
-                << std::endl;
-      return nullptr;
-    }
+  if (!expect(Token::RIGHT_BRACKET)) {
+    return false;
   }
+  consume();
 
-  return keyValueNode;
+  if (!sink.onTableBegin(tableName)) {
+    return false;
+  }
+  while (lexer.GetCurrentToken().type == Token::IDENTIFIER) {
+    if (!parseKey(sink)) {
+      return false;
+    }
+  }
+  return sink.onTableEnd();
 }
 
-std::shared_ptr<TOMLNode> Parser::parseArray() {
-  std::string arrayName = lexer.PervPrevToken().value;
-  expect(Token::LEFT_BRACKET);
+// Parses the value at the current token. Strings are handed on as views
+// into the source, or into `unescaped` if they had escapes to decode.
+template <typename Sink>
+bool Parser::parseValue(Sink& sink) {
+  SToken token = lexer.GetCurrentToken();
+  Value value;
+
+  switch (token.type) {
+    case Token::LEFT_BRACKET:
+      return parseArray(sink);
+    case Token::STRING: {
+      std::string_view text = token.value.substr(1, token.value.size() - 2);
+      if (text.find('\\') != std::string_view::npos) {
+        if (!parseString(text, unescaped)) {
+          fail("Invalid escape in string: " + std::string(token.value));
+          return false;
+        }
+        text = unescaped;
+      }
+      value = Value::string(text);
+      break;
+    }
+    case Token::NUMBER: {
+      int64_t integer;
+      if (!parseInteger(token.value, integer)) {
+        fail("Invalid integer: " + std::string(token.value));
+        return false;
+      }
+      value = Value::integer(integer);
+      break;
+    }
+    case Token::FLOAT: {
+      double floating;
+      if (!parseFloat(token.value, floating)) {
+        fail("Invalid float: " + std::string(token.value));
+        return false;
+      }
+      value = Value::floating(floating);
+      break;
+    }
+    case Token::BOOL:
+      value = Value::boolean(token.value == "true");
+      break;
+    default:
+      fail("Unexpected token: " + lexer.ToString(token.type));
+      return false;
+  }
   consume();
+  return sink.onScalar(value);
+}
 
-  std::vector<std::shared_ptr<TOMLNode>> elements;
+template <typename Sink>
+bool Parser::parseArray(Sink& sink) {
+  if (!expect(Token::LEFT_BRACKET)) {
+    return false;
+  }
+  consume();
 
+  if (!sink.onArrayBegin()) {
+    return false;
+  }
   while (lexer.GetCurrentToken().type != Token::RIGHT_BRACKET) {
-    Token currentToken = lexer.GetCurrentToken().type;
-    std::shared_ptr<TOMLNode> arrayElement;
-
-    if (currentToken == Token::STRING) {
-      std::string value = lexer.GetCurrentToken().value;
-      value = value.substr(1, value.size() - 1);
-      if (!value.empty()) {
-        arrayElement = std::make_shared<StringNode>(value);
-        elements.push_back(arrayElement);
-      }
-      consume();
-    } else if (currentToken == Token::FLOAT) {
-      double floatValue = std::stod(lexer.GetCurrentToken().value);
-      std::ostringstream stream;
-      stream << std::fixed << std::setprecision(2) << floatValue;
-      arrayElement = std::make_shared<FloatNode>(stream.str());
-      elements.push_back(arrayElement);
-      consume();
-    } else if (currentToken == Token::NUMBER) {
-      int intValue = std::stoi(lexer.GetCurrentToken().value);
-      arrayElement = std::make_shared<IntegerNode>(intValue);
-      elements.push_back(arrayElement);
-      consume();
-    } else if (currentToken == Token::BOOL) {
-      bool boolValue;
-      if (lexer.GetCurrentToken().value == "true") {
-        boolValue = true;
-      } else {
-        boolValue = false;
-      }
-      arrayElement = std::make_shared<BoolNode>(boolValue);
-      elements.push_back(arrayElement);
-      consume();
-    } else {
-      std::cerr << "Unexpected token in array: " << lexer.ToString(currentToken)
-                << std::endl;
-      return nullptr;
+    if (!parseValue(sink)) {
+      return false;
     }
 
     while (lexer.GetCurrentToken().type == Token::COMMA) {
       consume();
     }
   }
-
-  expect(Token::RIGHT_BRACKET);
   consume();
 
-  return std::make_shared<ArrayNode>(arrayName, elements);
+  return sink.onArrayEnd();
+}
+
+// Copies the items pushed onto `scratch` since `mark` into the arena.
+template <typename T>
+Span<T> Parser::collect(std::vector<T>& scratch, size_t mark) {
+  Span<T> items{document->arena.copy(scratch.data() + mark,
+                                     scratch.size() - mark),
+                scratch.size() - mark};
+  scratch.resize(mark);
+  return items;
+}
+
+// Builds "table.key" in the arena for the path index.
+std::string_view Parser::joinPath(std::string_view table,
+                                  std::string_view key) {
+  size_t size = table.size() + 1 + key.size();
+  char* path = static_cast<char*>(document->arena.allocate(size, 1));
+  std::memcpy(path, table.data(), table.size());
+  path[table.size()] = '.';
+  std::memcpy(path + table.size() + 1, key.data(), key.size());
+  return {path, size};
 }
 
 void Parser::printIR() {
-    for (const auto& node : parsedNodes) {
-        printNodeIR(node, 0);
+    for (const auto& entry : document->entries) {
+        printNodeIR(entry, 0);
     }
 }
 
-void Parser::printNodeIR(const std::shared_ptr<TOMLNode>& node, int indentLevel) {
+void Parser::printNodeIR(const KeyValue& entry, int indentLevel) {
     std::string indent(indentLevel * 2, ' ');
 
-    if (auto tableNode = std::dynamic_pointer_cast<TableNode>(node)) {
-        std::cout << indent << "Table: " << tableNode->name << std::endl;
-        for (const auto& entry : tableNode->entries) {
-            printNodeIR(entry, indentLevel + 1);
-        }
-    } else if (auto arrayNode = std::dynamic_pointer_cast<ArrayNode>(node)) {
-        std::cout << indent << "Array: " << arrayNode->array_name << std::endl;
-        for (const auto& element : arrayNode->elements) {
-            std::cout << "\t";
-            printValueNodeIR(element, indentLevel + 1);
-        }
-    } else if (auto keyValueNode = std::dynamic_pointer_cast<KeyValueNode>(node)) {
-        std::cout << indent << "Key: " << keyValueNode->key << ", Value: ";
-        printValueNodeIR(keyValueNode->value, indentLevel);
+    switch (entry.value.kind()) {
+        case Kind::Table:
+            std::cout << indent << "Table: " << entry.key << std::endl;
+            for (const auto& child : entry.value.asTable()) {
+                printNodeIR(child, indentLevel + 1);
+            }
+            break;
+        case Kind::Array:
+            std::cout << indent << "Array: " << entry.key << std::endl;
+            for (const auto& element : entry.value.asArray()) {
+                std::cout << "\t";
+                printValueNodeIR(element, indentLevel + 1);
+            }
+            break;
+        default:
+            std::cout << indent << "Key: " << entry.key << ", Value: ";
+            printValueNodeIR(entry.value, indentLevel);
+            break;
     }
 }
 
 
-void Parser::printValueNodeIR(const std::shared_ptr<TOMLNode>& node, int indentLevel) {
+void Parser::printValueNodeIR(const Value& value, int indentLevel) {
   std::string indent(indentLevel * 2, ' ');
 
-  if (auto stringNode = std::dynamic_pointer_cast<StringNode>(node)) {
-    std::cout << "String: " << stringNode->value << std::endl;
-  } else if (auto integerNode = std::dynamic_pointer_cast<IntegerNode>(node)) {
-    std::cout << "Integer: " << integerNode->value << std::endl;
-  } else if (auto floatNode = std::dynamic_pointer_cast<FloatNode>(node)) {
-    std::cout << "Float: " << std::fixed << std::setprecision(6) << floatNode->value << std::endl;
-  } else if (auto boolNode = std::dynamic_pointer_cast<BoolNode>(node)) {
-    std::cout << "Bool: " << (boolNode->value ? "true" : "false") << std::endl;
-  } else if (auto arrayNode = std::dynamic_pointer_cast<ArrayNode>(node)) {
-    std::cout << "Array: " << arrayNode->array_name << std::endl;
-    for (const auto& element : arrayNode->elements) {
-      std::cout << indent << "  ";
-      printValueNodeIR(element, indentLevel + 1);
-    }
+  switch (value.kind()) {
+    case Kind::String:
+      std::cout << "String: " << value.asString() << std::endl;
+      break;
+    case Kind::Integer:
+      std::cout << "Integer: " << value.asInteger() << std::endl;
+      break;
+    case Kind::Float:
+      std::cout << "Float: " << floatToString(value.asFloat()) << std::endl;
+      break;
+    case Kind::Bool:
+      std::cout << "Bool: " << (value.asBool() ? "true" : "false")
+                << std::endl;
+      break;
+    case Kind::Array:
+      std::cout << "Array:" << std::endl;
+      for (const auto& element : value.asArray()) {
+        std::cout << indent << "  ";
+        printValueNodeIR(element, indentLevel + 1);
+      }
+      break;
+    default:
+      break;
   }
 }
 
 
 
-std::string Parser::getValueByKey(const std::string& key) {
-  for (const auto& node : parsedNodes) {
-    if (auto arrayNode = std::dynamic_pointer_cast<ArrayNode>(node)) {
-      if (arrayNode->array_name == key) {
-        std::string arrayValue = "[";
-
-        for (size_t i = 0; i < arrayNode->elements.size(); ++i) {
-          const auto& element = arrayNode->elements[i];
-          if (auto stringElement =
-                  std::dynamic_pointer_cast<StringNode>(element)) {
-            arrayValue += stringElement->value;
-          } else if (auto intElement =
-                         std::dynamic_pointer_cast<IntegerNode>(element)) {
-            arrayValue += std::to_string(intElement->value);
-          } else if (auto floatElement =
-                         std::dynamic_pointer_cast<FloatNode>(element)) {
-            arrayValue += floatElement->value;
-          }
-
-          if (i != arrayNode->elements.size() - 1) {
-            arrayValue += ",";
-          }
-        }
+std::string Parser::getValueByKey(std::string_view key) {
+  const Value* value = document->find(key);
+  if (value && value->kind() == Kind::Array) {
+    std::string arrayValue = "[";
+    Span<const Value> elements = value->asArray();
 
-        arrayValue += "]";
-        return arrayValue;
-      }
-    } else if (auto keyValueNode =
-                   std::dynamic_pointer_cast<KeyValueNode>(node)) {
-      if (keyValueNode->key == key) {
-        auto valueNode = keyValueNode->value;
-
-        if (auto stringNode =
-                std::dynamic_pointer_cast<StringNode>(valueNode)) {
-          return stringNode->value;
-        } else if (auto intNode =
-                       std::dynamic_pointer_cast<IntegerNode>(valueNode)) {
-          return std::to_string(intNode->value);
-        } else if (auto floatNode =
-                       std::dynamic_pointer_cast<FloatNode>(valueNode)) {
-          return floatNode->value;
-        } else if (auto boolNode =
-                       std::dynamic_pointer_cast<BoolNode>(valueNode)) {
-          return boolNode->value ? "true" : "false";
-        }
+    for (size_t i = 0; i < elements.size(); ++i) {
+      arrayValue += scalarToString(elements[i]);
+      if (i != elements.size() - 1) {
+        arrayValue += ",";
       }
     }
+
+    arrayValue += "]";
+    return arrayValue;
+  } else if (value && value->kind() != Kind::Table) {
+    return scalarToString(*value);
   }
-  return "ERROR: Could not find \"" + key + "\" in file " + file_path;
+  return "ERROR: Could not find \"" + std::string(key) + "\" in file " +
+         file_path;
 }
 
 
-std::string Parser::getTableValue(const std::string& tableAndKey) {
+std::string Parser::getTableValue(std::string_view tableAndKey) {
     size_t dotPos = tableAndKey.find('.');
-    if (dotPos == std::string::npos) {
+    if (dotPos == std::string_view::npos) {
         return "ERROR: Invalid table.key format";
     }
 
-    std::string tableName = tableAndKey.substr(0, dotPos);
-    std::string key = tableAndKey.substr(dotPos + 1);
-
-    for (const auto& node : parsedNodes) {
-        if (auto tableNode = std::dynamic_pointer_cast<TableNode>(node)) {
-            if (tableNode->name == tableName) {
-                for (const auto& entry : tableNode->entries) {
-                    if (auto keyValueNode =
-                            std::dynamic_pointer_cast<KeyValueNode>(entry)) {
-                        if (keyValueNode->key == key) {
-                            if (auto arrayNode =
-                                    std::dynamic_pointer_cast<ArrayNode>(
-                                        keyValueNode->value)) {
-                                if (!arrayNode->elements.empty()) {
-                                    if (auto stringNode =
-                                            std::dynamic_pointer_cast<StringNode>(
-                                                arrayNode->elements[0])) {
-                                        return stringNode->value;
-                                    } else if (auto intNode =
-                                            std::dynamic_pointer_cast<IntegerNode>(
-                                                arrayNode->elements[0])) {
-                                        return std::to_string(intNode->value);
-                                    } else if (auto floatNode =
-                                            std::dynamic_pointer_cast<FloatNode>(
-                                                arrayNode->elements[0])) {
-                                        return floatNode->value;
-                                    } else if (auto boolNode =
-                                            std::dynamic_pointer_cast<BoolNode>(
-                                                arrayNode->elements[0])) {
-                                        return boolNode->value ? "true" : "false";
-                                    }
-                                }
-                            } else {
-                                if (auto stringNode =
-                                        std::dynamic_pointer_cast<StringNode>(
-                                            keyValueNode->value)) {
-                                    return stringNode->value;
-                                } else if (auto intNode =
-                                            std::dynamic_pointer_cast<IntegerNode>(
-                                                keyValueNode->value)) {
-                                    return std::to_string(intNode->value);
-                                } else if (auto floatNode =
-                                            std::dynamic_pointer_cast<FloatNode>(
-                                                keyValueNode->value)) {
-                                    return floatNode->value;
-                                } else if (auto boolNode =
-                                            std::dynamic_pointer_cast<BoolNode>(
-                                                keyValueNode->value)) {
-                                    return boolNode->value ? "true" : "false";
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+    const Value* value = document->find(tableAndKey);
+    if (value && value->kind() == Kind::Array) {
+        // Arrays report their first element.
+        if (!value->asArray().empty()) {
+            return scalarToString(value->asArray()[0]);
         }
+    } else if (value && value->kind() != Kind::Table) {
+        return scalarToString(*value);
     }
+
+    std::string tableName(tableAndKey.substr(0, dotPos));
+    std::string key(tableAndKey.substr(dotPos + 1));
     return "ERROR: Could not find value for key \"" + key + "\" in table \"" + tableName + "\" in file " + file_path;
 }
-
-
-
@@ -1,48 +1,210 @@
-#include "ast.hpp"
+#pragma once
+#include "document.hpp"
+#include "events.hpp"
 #include "lexer.hpp"
-#include <iomanip>
+#include "numbers.hpp"
+#include "stats.hpp"
 #include <iostream>
-#include <sstream>
+#include <string>
 
 namespace GTOML {
-    typedef std::shared_ptr<TOMLNode> Node;
     class Parser {
         public:
 
-            Parser(std::string file_path) : lexer(file_path) {
+            // With `threads` > 1 a large document is split at its table
+            // headers and the sections are parsed concurrently; see
+            // parseParallel(). With `stats`, every phase of loading and of
+            // later parses and edits is recorded there; see Stats.
+            Parser(std::string file_path, Input input = Input::Read,
+                   unsigned threads = 1, Stats* stats = nullptr)
+                : lexer(file_path), stats(stats) {
                 file_path = file_path.substr(0, file_path.find_last_of('.'));
-                lexer.read();
-                lexer.lex();
-                lexer.toknizer();
-                Parse();
+                {
+                    Stats::Scope loading(stats, input == Input::Map ? "map"
+                                                                    : "read");
+                    if (input == Input::Map) {
+                        lexer.map();
+                    } else {
+                        lexer.read();
+                    }
+                    if (loading.enabled() && lexer.hasSource()) {
+                        loading.end();
+                        loading.items = lexer.getSource()->view().size();
+                    }
+                }
+                parseParallel(threads);
             };
+
+            // Parses TOML text that is already in memory, e.g. a blob
+            // received over RPC or an embedded resource.
+            explicit Parser(std::shared_ptr<const Source> source,
+                            unsigned threads = 1, Stats* stats = nullptr)
+                : lexer(source), stats(stats) {
+                parseParallel(threads);
+            };
+            Parser(const char* data, size_t size)
+                : Parser(Source::copy(std::string_view(data, size))) {}
+
             bool Parse();
 
+            // Splits the source at top-level table headers and parses the
+            // sections on up to `threads` threads, then merges them in
+            // source order. The document, its index and any error are the
+            // same as Parse() would produce: if a section fails, the
+            // partial results are dropped and the source is parsed again
+            // sequentially so errors are reported exactly as before.
+            bool parseParallel(unsigned threads);
+
+            // The first error of the last parse, or "" if it succeeded.
+            const std::string& getError() const { return error; }
+
+            // Replaces the document with one parsed from `source`, e.g. the
+            // file re-read after it changed. The new document gets a new
+            // generation, so existing KeyHandles re-resolve on next use.
+            bool reparse(std::shared_ptr<const Source> source);
+
+            // Applies an edit to the parsed text. `edited` is the whole text
+            // after the edit, in which the `removed` bytes at `offset` of
+            // the previous text were replaced by `inserted` bytes. Only the
+            // top-level sections (the keys before the first table, and
+            // each [table]) that the edit touches are lexed and parsed
+            // again; their entries are spliced into the document and every
+            // other table is kept as it is. The document gets a new
+            // generation. When the edit cannot be confined to its sections,
+            // e.g. it breaks a header or defines a path another section
+            // already has, the whole text is reparsed instead, so the
+            // result always equals reparse(edited).
+            //
+            // Memory of the replaced sections stays in the arena until the
+            // next full parse.
+            bool applyEdit(std::shared_ptr<const Source> edited, size_t offset,
+                           size_t removed, size_t inserted);
+
             void printIR();
 
 
-            std::string getValueByKey(const std::string& key);
-            std::string getTableValue(const std::string& key);
+            const Document& getDocument() const { return *document; }
+
+            // The parsed document as an immutable snapshot, or nullptr if
+            // the last parse failed. The snapshot is never modified again:
+            // reparse() builds a new document, and applyEdit() edits a copy
+            // while a snapshot is held. Any number of threads may read it
+            // without locking and it outlives the parser.
+            std::shared_ptr<const Document> snapshot() const {
+                return parsed ? document : nullptr;
+            }
+
+            // Typed lookup by dotted path, e.g. get<int64_t>("server.port").
+            // Returns nullopt when the key is missing or of another kind.
+            template <typename T>
+            std::optional<T> get(std::string_view path) const {
+                return document->get<T>(path);
+            }
+
+            // Compiles `path` once for lookups in a loop:
+            //   KeyHandle port = parser.compile("server.port");
+            //   parser.get<int64_t>(port);
+            KeyHandle compile(std::string_view path) const {
+                return document->compile(path);
+            }
+            template <typename T>
+            std::optional<T> get(const KeyHandle& handle) const {
+                return document->get<T>(handle);
+            }
+
+            // Both accept a full dotted path and resolve it with a single
+            // hash lookup in the document's index.
+            std::string getValueByKey(std::string_view key);
+            std::string getTableValue(std::string_view key);
 
         private:
             Lexer lexer;
             std::string file_path;
-            std::vector<Node> parsedNodes;
+            std::shared_ptr<Document> document = std::make_shared<Document>();
+            std::string error;
+            bool parsed = false;  // the whole source has been parsed
+            bool quiet = false;   // record errors without printing them
+            Stats* stats = nullptr;
+            const char* phase = "parse";  // what Parse() records itself as
+            // Entries of the table and items of the array being parsed;
+            // copied into the arena once the table or array is complete.
+            std::vector<KeyValue> entryScratch;
+            std::vector<Value> valueScratch;
+            std::string unescaped;  // the last string with escapes, decoded
+
+            // Where each top-level section starts in the source and its
+            // first entry in document.entries. extents[0] is the run of
+            // keys before the first table; the others start at a '['.
+            // Built by the first applyEdit() and kept in step with it.
+            struct Extent {
+                size_t begin;
+                size_t firstEntry;
+            };
+            std::vector<Extent> extents;
+            bool buildExtents();
+            size_t extentAt(size_t offset) const;
+
+            // A section of a parallel parse or a table of a LazyDocument:
+            // parsed immediately, quietly.
+            friend class LazyDocument;
+            struct Section {};
+            Parser(Section, std::string_view text, Stats* stats = nullptr);
+
+            // A BatchLoader worker: starts empty and parses each input
+            // through reparse(), reusing the scratch buffers, quietly.
+            friend class BatchLoader;
+            struct Worker {};
+            explicit Parser(Worker)
+                : lexer(std::shared_ptr<const Source>()), quiet(true) {}
 
+            // Parse() without recording a phase.
+            bool build();
+            // Fills in what a phase that built the document produced.
+            void tally(Stats::Scope& scope, uint64_t tokens, size_t bytes);
+
+            void fail(const std::string& message);
             bool expect(Token token);
             void consume();
 
-            Node parseKey();
-            Node parseArray();
-            Node parseTable();
-            Node parseTableKey();
-            Node parseTableArray();
-            Node getNode(const std::string& key);
+            // The grammar. It reports what it reads to a sink with the
+            // methods of Handler: a Builder, which assembles the document,
+            // or the caller's Handler in parseEvents().
+            template <typename Sink>
+            bool parseDocument(Sink& sink);
+            template <typename Sink>
+            bool parseKey(Sink& sink);
+            template <typename Sink>
+            bool parseTable(Sink& sink);
+            template <typename Sink>
+            bool parseValue(Sink& sink);
+            template <typename Sink>
+            bool parseArray(Sink& sink);
+
+            class Builder;
+            friend bool parseEvents(std::shared_ptr<const Source> source,
+                                    Handler& handler, std::string* error);
 
+            template <typename T>
+            Span<T> collect(std::vector<T>& scratch, size_t mark);
+            std::string_view intern(std::string_view text) {
+                return document->strings.intern(text, document->arena);
+            }
+            std::string_view joinPath(std::string_view table,
+                                      std::string_view key);
 
-            void printValueNodeIR(const Node& node, int indentLevel);
-            void printNodeIR(const Node& node, int indentLevel);
+
+            void printValueNodeIR(const Value& value, int indentLevel);
+            void printNodeIR(const KeyValue& entry, int indentLevel);
 
 
     };
+
+    // Parses `source` into an immutable document. The lexer, tokens and
+    // parser scratch are freed before it returns, so only the document
+    // stays in memory. Returns nullptr on a parse error, which is stored in
+    // `error` if given. The phases are recorded in `stats` if given.
+    std::shared_ptr<const Document> parse(std::shared_ptr<const Source> source,
+                                          std::string* error = nullptr,
+                                          unsigned threads = 1,
+                                          Stats* stats = nullptr);
 }  // namespace GTOML
@@ -0,0 +1,161 @@
+#include "reload.hpp"
+
+#include <chrono>
+
+#include "batch.hpp"
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace GTOML;
+
+// The watch is set up before the first parse, so a change made while it
+// runs is not missed.
+ReloadableDocument::ReloadableDocument(std::string path, Input input)
+    : path(std::move(path)), input(input) {
+  startWatching();
+  if (!reload()) {
+    std::lock_guard<std::mutex> lock(reloading);
+    publish(new Document());
+  }
+  watcher = std::thread([this] { watch(); });
+}
+
+ReloadableDocument::~ReloadableDocument() {
+  stopping = true;
+#if defined(__linux__)
+  if (stopSignal >= 0) {
+    uint64_t one = 1;
+    (void)::write(stopSignal, &one, sizeof(one));
+  }
+#endif
+  watcher.join();
+#if defined(__linux__)
+  if (stopSignal >= 0) {
+    ::close(stopSignal);
+  }
+  if (events >= 0) {
+    ::close(events);
+  }
+#endif
+  delete current.load();
+}
+
+ReloadableDocument::Reader ReloadableDocument::read() const {
+  // Pin the epoch first and load the document second. If a publisher
+  // flipped the epoch in between, it may not have seen our pin, so drop it
+  // and pin the new epoch instead.
+  for (;;) {
+    uint64_t seen = epoch.load();
+    std::atomic<uint64_t>& counter = pins[seen & 1];
+    counter.fetch_add(1);
+    if (epoch.load() == seen) {
+      return Reader(current.load(), &counter);
+    }
+    counter.fetch_sub(1);
+  }
+}
+
+bool ReloadableDocument::reload() {
+  std::lock_guard<std::mutex> lock(reloading);
+  BatchResult result = std::move(BatchLoader(1).loadFiles({path}, input)[0]);
+  if (!result.ok()) {
+    error = result.error;
+    return false;
+  }
+  error.clear();
+  publish(new Document(std::move(result.document)));
+  return true;
+}
+
+std::string ReloadableDocument::lastError() const {
+  std::lock_guard<std::mutex> lock(reloading);
+  return error;
+}
+
+// Swaps in `document` and frees the previous one once every reader that
+// may have loaded it has let go. Called with `reloading` held.
+void ReloadableDocument::publish(const Document* document) {
+  const Document* previous = current.exchange(document);
+  uint64_t old = epoch.fetch_add(1);
+  while (pins[old & 1].load() != 0) {
+    std::this_thread::yield();
+  }
+  delete previous;
+  ++published;
+}
+
+#if defined(__linux__)
+
+// Watches the directory rather than the file, so that editors which save by
+// writing a new file and renaming it over the old one are followed too.
+void ReloadableDocument::startWatching() {
+  Source::stat(path, size, mtime);
+  size_t slash = path.find_last_of('/');
+  std::string directory = slash == std::string::npos ? "."
+                          : slash == 0               ? "/"
+                                                     : path.substr(0, slash);
+  name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+  stopSignal = ::eventfd(0, EFD_CLOEXEC);
+  events = ::inotify_init1(IN_CLOEXEC);
+  if (events >= 0 && ::inotify_add_watch(events, directory.c_str(),
+                                         IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    ::close(events);
+    events = -1;
+  }
+}
+
+void ReloadableDocument::watch() {
+  if (events < 0 || stopSignal < 0) {
+    pollFile();
+    return;
+  }
+
+  alignas(inotify_event) char buffer[4096];
+  pollfd fds[2] = {{events, POLLIN, 0}, {stopSignal, POLLIN, 0}};
+  while (!stopping) {
+    if (::poll(fds, 2, -1) < 0 || (fds[1].revents & POLLIN)) {
+      continue;
+    }
+    ssize_t length = ::read(events, buffer, sizeof(buffer));
+    bool changed = false;
+    for (ssize_t at = 0; at < length;) {
+      const inotify_event* event =
+          reinterpret_cast<const inotify_event*>(buffer + at);
+      changed = changed || (event->len && name == event->name);
+      at += sizeof(inotify_event) + event->len;
+    }
+    if (changed) {
+      reload();
+    }
+  }
+}
+
+#else
+
+void ReloadableDocument::startWatching() { Source::stat(path, size, mtime); }
+
+void ReloadableDocument::watch() { pollFile(); }
+
+#endif
+
+// Without inotify, checks the file's size and modification time a few
+// times a second.
+void ReloadableDocument::pollFile() {
+  while (!stopping) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    uint64_t newSize = 0;
+    int64_t newMtime = 0;
+    if (Source::stat(path, newSize, newMtime) &&
+        (newSize != size || newMtime != mtime)) {
+      size = newSize;
+      mtime = newMtime;
+      reload();
+    }
+  }
+}
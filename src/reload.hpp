@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "document.hpp"
+#include "source.hpp"
+
+namespace GTOML {
+// A document that follows its file. A watcher thread notices when the file
+// is written or replaced (inotify on Linux, polling the modification time
+// elsewhere), parses it off the reading threads and publishes the new
+// document with one atomic pointer swap.
+//
+// Readers pin the current document with read(). Pinning never takes a lock
+// and never waits for a reload: it bumps a counter for the current epoch.
+// The publisher flips the epoch after the swap and frees the old document
+// once the readers of the old epoch have all let go, in the style of RCU.
+// A reader therefore always sees one complete document, and a document is
+// freed only after its last reader is done with it.
+//
+// A file that fails to parse is not published; the previous document stays
+// current and the error is kept in lastError().
+class ReloadableDocument {
+ public:
+  // A pinned document. Keep it for the duration of one unit of work, e.g.
+  // one request, not for the life of the thread: a reload cannot free the
+  // previous document while any Reader of its epoch is alive.
+  class Reader {
+   public:
+    Reader(Reader&& other) noexcept
+        : document(other.document), pins(other.pins) {
+      other.pins = nullptr;
+    }
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+    ~Reader() {
+      if (pins) {
+        pins->fetch_sub(1, std::memory_order_release);
+      }
+    }
+
+    const Document& operator*() const { return *document; }
+    const Document* operator->() const { return document; }
+
+   private:
+    friend class ReloadableDocument;
+    Reader(const Document* document, std::atomic<uint64_t>* pins)
+        : document(document), pins(pins) {}
+
+    const Document* document;
+    std::atomic<uint64_t>* pins;
+  };
+
+  // Parses `path` and starts watching it. If the first parse fails, the
+  // current document is empty until the file is fixed.
+  explicit ReloadableDocument(std::string path, Input input = Input::Read);
+  ReloadableDocument(const ReloadableDocument&) = delete;
+  ReloadableDocument& operator=(const ReloadableDocument&) = delete;
+  // Stops the watcher. Every Reader must be gone by then.
+  ~ReloadableDocument();
+
+  // Pins the current document. Safe from any thread; never blocks.
+  Reader read() const;
+
+  // Parses the file now on the calling thread and publishes the result.
+  // Returns false, keeping the current document, if it does not parse.
+  // Waits for the readers of the previous document, so the calling thread
+  // must not hold a Reader.
+  bool reload();
+
+  // How many documents have been published, including the first.
+  uint64_t version() const { return published.load(); }
+  // The error of the last failed parse, or "" if the last one succeeded.
+  std::string lastError() const;
+  const std::string& getPath() const { return path; }
+
+ private:
+  void publish(const Document* document);
+  void startWatching();
+  void watch();
+  void pollFile();
+
+  std::string path;
+  Input input;
+
+  std::atomic<const Document*> current{nullptr};
+  std::atomic<uint64_t> epoch{0};
+  mutable std::atomic<uint64_t> pins[2] = {};
+  std::atomic<uint64_t> published{0};
+
+  mutable std::mutex reloading;  // one publisher at a time; guards error
+  std::string error;
+
+  std::atomic<bool> stopping{false};
+  int stopSignal = -1;  // written to wake the watcher when stopping
+  int events = -1;      // inotify descriptor, or -1 to poll instead
+  std::string name;     // the file name within its directory
+  uint64_t size = 0;    // the file as last polled
+  int64_t mtime = 0;
+  std::thread watcher;
+};
+}  // namespace GTOML
@@ -0,0 +1,198 @@
+#include "scanner.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define GTOML_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace GTOML;
+
+namespace {
+typedef void (*ClassifyFn)(const char* block, uint64_t* masks);
+
+void classifyScalar(const char* block, uint64_t* masks) {
+  uint64_t special = 0, nonBlank = 0, stringEnd = 0, newline = 0,
+           structure = 0;
+  for (int i = 0; i < 64; ++i) {
+    char c = block[i];
+    uint8_t cls = charClass(c);
+    uint64_t bit = uint64_t(1) << i;
+    if (cls != kBare) {
+      special |= bit;
+    }
+    if (cls != kBlank) {
+      nonBlank |= bit;
+    }
+    if (c == '"' || c == '\\' || c == '\n') {
+      stringEnd |= bit;
+    }
+    if (c == '\n') {
+      newline |= bit;
+    }
+    if (cls == kLeftBracket || cls == kRightBracket || cls == kEqual ||
+        cls == kQuote || cls == kHash) {
+      structure |= bit;
+    }
+  }
+  masks[Scanner::kSpecial] = special;
+  masks[Scanner::kNonBlank] = nonBlank;
+  masks[Scanner::kStringEnd] = stringEnd;
+  masks[Scanner::kNewline] = newline;
+  masks[Scanner::kStructure] = structure;
+}
+
+#if GTOML_X86
+void classifySse2(const char* block, uint64_t* masks) {
+  uint64_t special = 0, blank = 0, stringEnd = 0, newline = 0, structure = 0;
+  for (int i = 0; i < 64; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+    auto is = [v](char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); };
+
+    __m128i nl = is('\n');
+    __m128i quote = is('"');
+    __m128i blanks =
+        _mm_or_si128(_mm_or_si128(nl, is(' ')), _mm_or_si128(is('\t'), is('\r')));
+    __m128i brackets = _mm_or_si128(is('['), is(']'));
+    __m128i equal = is('=');
+    __m128i quoteOrHash = _mm_or_si128(quote, is('#'));
+    __m128i punctuation = _mm_or_si128(
+        _mm_or_si128(brackets, _mm_or_si128(equal, is(','))), quoteOrHash);
+
+    special |= uint64_t(_mm_movemask_epi8(_mm_or_si128(blanks, punctuation)))
+               << i;
+    blank |= uint64_t(_mm_movemask_epi8(blanks)) << i;
+    stringEnd |= uint64_t(_mm_movemask_epi8(
+                     _mm_or_si128(_mm_or_si128(quote, is('\\')), nl)))
+                 << i;
+    newline |= uint64_t(_mm_movemask_epi8(nl)) << i;
+    structure |= uint64_t(_mm_movemask_epi8(_mm_or_si128(
+                     _mm_or_si128(brackets, equal), quoteOrHash)))
+                 << i;
+  }
+  masks[Scanner::kSpecial] = special;
+  masks[Scanner::kNonBlank] = ~blank;
+  masks[Scanner::kStringEnd] = stringEnd;
+  masks[Scanner::kNewline] = newline;
+  masks[Scanner::kStructure] = structure;
+}
+
+__attribute__((target("avx2"))) void classifyAvx2(const char* block,
+                                                  uint64_t* masks) {
+  uint64_t special = 0, blank = 0, stringEnd = 0, newline = 0, structure = 0;
+  for (int i = 0; i < 64; i += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+    auto is = [v](char c) __attribute__((target("avx2"))) {
+      return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+    };
+
+    __m256i nl = is('\n');
+    __m256i quote = is('"');
+    __m256i blanks = _mm256_or_si256(_mm256_or_si256(nl, is(' ')),
+                                     _mm256_or_si256(is('\t'), is('\r')));
+    __m256i brackets = _mm256_or_si256(is('['), is(']'));
+    __m256i equal = is('=');
+    __m256i quoteOrHash = _mm256_or_si256(quote, is('#'));
+    __m256i punctuation = _mm256_or_si256(
+        _mm256_or_si256(brackets, _mm256_or_si256(equal, is(','))),
+        quoteOrHash);
+
+    special |= uint64_t(uint32_t(_mm256_movemask_epi8(
+                   _mm256_or_si256(blanks, punctuation))))
+               << i;
+    blank |= uint64_t(uint32_t(_mm256_movemask_epi8(blanks))) << i;
+    stringEnd |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_or_si256(
+                     _mm256_or_si256(quote, is('\\')), nl))))
+                 << i;
+    newline |= uint64_t(uint32_t(_mm256_movemask_epi8(nl))) << i;
+    structure |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_or_si256(
+                     _mm256_or_si256(brackets, equal), quoteOrHash))))
+                 << i;
+  }
+  masks[Scanner::kSpecial] = special;
+  masks[Scanner::kNonBlank] = ~blank;
+  masks[Scanner::kStringEnd] = stringEnd;
+  masks[Scanner::kNewline] = newline;
+  masks[Scanner::kStructure] = structure;
+}
+#endif
+
+ClassifyFn classifierFor(simd::Backend backend) {
+  switch (backend) {
+#if GTOML_X86
+    case simd::Backend::AVX2:
+      return classifyAvx2;
+    case simd::Backend::SSE2:
+      return classifySse2;
+#endif
+    default:
+      return classifyScalar;
+  }
+}
+
+simd::Backend detectBackend() {
+#if GTOML_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return simd::Backend::AVX2;
+  }
+  return simd::Backend::SSE2;
+#else
+  return simd::Backend::Scalar;
+#endif
+}
+
+struct Dispatch {
+  simd::Backend backend;
+  ClassifyFn classify;
+};
+
+Dispatch& dispatch() {
+  static Dispatch current{simd::bestBackend(),
+                          classifierFor(simd::bestBackend())};
+  return current;
+}
+}  // namespace
+
+simd::Backend simd::bestBackend() {
+  static const Backend best = detectBackend();
+  return best;
+}
+
+simd::Backend simd::activeBackend() { return dispatch().backend; }
+
+void simd::setBackend(Backend backend) {
+  if (backend > bestBackend()) {
+    backend = bestBackend();
+  }
+  dispatch() = {backend, classifierFor(backend)};
+}
+
+const char* simd::backendName(Backend backend) {
+  switch (backend) {
+    case Backend::AVX2:
+      return "avx2";
+    case Backend::SSE2:
+      return "sse2";
+    case Backend::Scalar:
+      return "scalar";
+  }
+  return "unknown";
+}
+
+void Scanner::load(size_t index) {
+  block = index;
+  size_t offset = index << 6;
+  if (input.size() - offset >= 64) {
+    dispatch().classify(input.data() + offset, masks);
+    return;
+  }
+
+  // The last block is padded with blanks; find() clamps to the input size.
+  char tail[64];
+  std::memset(tail, ' ', sizeof(tail));
+  std::memcpy(tail, input.data() + offset, input.size() - offset);
+  dispatch().classify(tail, masks);
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace GTOML {
+// Character classes driving the lexer. The SIMD classifiers in scanner.cpp
+// test for the same bytes and must be kept in sync with this table.
+enum CharClass : uint8_t {
+  kBare,  // part of a key, number or boolean
+  kBlank,
+  kLeftBracket,
+  kRightBracket,
+  kEqual,
+  kComma,
+  kQuote,
+  kHash,
+};
+
+constexpr std::array<uint8_t, 256> makeCharClasses() {
+  std::array<uint8_t, 256> classes{};
+  classes[' '] = kBlank;
+  classes['\t'] = kBlank;
+  classes['\r'] = kBlank;
+  classes['\n'] = kBlank;
+  classes['['] = kLeftBracket;
+  classes[']'] = kRightBracket;
+  classes['='] = kEqual;
+  classes[','] = kComma;
+  classes['"'] = kQuote;
+  classes['#'] = kHash;
+  return classes;
+}
+
+inline constexpr std::array<uint8_t, 256> kCharClass = makeCharClasses();
+
+inline uint8_t charClass(char c) {
+  return kCharClass[static_cast<unsigned char>(c)];
+}
+
+namespace simd {
+enum class Backend { Scalar, SSE2, AVX2 };
+
+// The widest backend the running CPU supports; chosen once at startup.
+Backend bestBackend();
+Backend activeBackend();
+// Forces a backend, e.g. to benchmark against the scalar fallback. Requests
+// for a backend the CPU lacks fall back to bestBackend(). Not thread-safe:
+// call it before any lexing starts.
+void setBackend(Backend backend);
+const char* backendName(Backend backend);
+}  // namespace simd
+
+// Finds the next interesting byte in the input. The input is classified in
+// 64-byte blocks into one bitmask per Mask, and find() jumps to the next set
+// bit, so long strings, comments and runs of blanks are skipped without
+// visiting every byte. Positions must be queried in increasing order.
+class Scanner {
+ public:
+  enum Mask {
+    kSpecial,    // any byte that ends a bare token
+    kNonBlank,   // any byte that is not a space, tab or newline
+    kStringEnd,  // '"', '\\' or '\n'
+    kNewline,
+    kStructure,  // '[', ']', '=', '"' or '#'
+    kMaskCount,
+  };
+
+  explicit Scanner(std::string_view input) : input(input) {}
+
+  // Returns the first position >= pos whose byte is in `mask`, or the input
+  // size when there is none.
+  size_t find(size_t pos, Mask mask) {
+    while (pos < input.size()) {
+      size_t index = pos >> 6;
+      if (index != block) {
+        load(index);
+      }
+      uint64_t bits = masks[mask] >> (pos & 63);
+      if (bits != 0) {
+        size_t found = pos + __builtin_ctzll(bits);
+        return found < input.size() ? found : input.size();
+      }
+      pos = (index + 1) << 6;
+    }
+    return input.size();
+  }
+
+ private:
+  void load(size_t index);
+
+  std::string_view input;
+  size_t block = SIZE_MAX;
+  uint64_t masks[kMaskCount] = {};
+};
+}  // namespace GTOML
@@ -0,0 +1,526 @@
+#include "snapshot.hpp"
+
+#include <sys/stat.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "parser.hpp"
+
+using namespace GTOML;
+
+// The file is a Header followed by five 8-byte aligned sections:
+//
+//   values   Record[valueCount]   array items
+//   entries  Entry[entryCount]    table entries; the first rootCount are
+//                                 the top-level keys and tables
+//   paths    Path[pathCount]      every dotted path and its value
+//   index    Slot[slotCount]      open-addressing table over `paths`
+//   strings  char[stringBytes]    keys, paths and string values
+//
+// A Record is a Value with offsets in place of pointers: strings point into
+// `strings`, arrays into `values` and tables into `entries`.
+struct Snapshot::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t sourceHash;
+  uint64_t sourceSize;
+  int64_t sourceMtime;
+  uint64_t valueCount;
+  uint64_t entryCount;
+  uint64_t rootCount;
+  uint64_t pathCount;
+  uint64_t slotCount;  // a power of two, or 0
+  uint64_t stringBytes;
+};
+
+struct Snapshot::Record {
+  uint64_t payload;  // offset, first index or the scalar's bits
+  uint32_t length;
+  uint8_t kind;
+  uint8_t padding[3];
+};
+
+struct Snapshot::Entry {
+  uint32_t keyOffset;
+  uint32_t keyLength;
+  Record value;
+};
+
+struct Snapshot::Path {
+  uint32_t offset;
+  uint32_t length;
+  Record value;
+};
+
+// Slots stay small so probing touches few cache lines; the low bits of the
+// hash filter out most mismatches before the path is compared.
+struct Snapshot::Slot {
+  uint32_t hash;
+  uint32_t path;  // index into paths, or kEmptySlot
+};
+
+namespace {
+constexpr char kMagic[8] = {'G', 'T', 'O', 'M', 'L', 'S', 'N', 'P'};
+constexpr uint32_t kVersion = 2;  // 2: sourceMtime in nanoseconds
+constexpr uint32_t kByteOrder = 0x01020304;
+constexpr uint32_t kEmptySlot = UINT32_MAX;
+
+size_t align8(size_t size) { return (size + 7) & ~size_t(7); }
+
+// Writes through a temporary file and a rename, so a reader maps either the
+// old snapshot or the new one. Each writer gets a temporary file of its own
+// in the same directory, so concurrent writers never write into each
+// other's file and the last rename wins with a whole snapshot.
+bool writeFile(const std::string& bytes, const std::string& path) {
+#if defined(_WIN32)
+  static std::atomic<uint64_t> writes{0};
+  std::string temporary = path + ".tmp." + std::to_string(::_getpid()) +
+                          "." + std::to_string(writes++);
+  std::fstream file(temporary.data(),
+                    std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return false;
+  }
+  file.write(bytes.data(), bytes.size());
+  file.close();
+  bool written = static_cast<bool>(file);
+#else
+  std::string temporary = path + ".XXXXXX";
+  int fd = ::mkstemp(&temporary[0]);
+  if (fd < 0) {
+    return false;
+  }
+  // mkstemp creates the file readable by its owner only.
+  bool written = ::fchmod(fd, 0644) == 0;
+  for (size_t done = 0; written && done < bytes.size();) {
+    ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+    written = n > 0;
+    done += written ? n : 0;
+  }
+  written = ::close(fd) == 0 && written;
+#endif
+  if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+}  // namespace
+
+uint64_t GTOML::hashBytes(std::string_view bytes) {
+  const uint64_t kMultiplier = 0x9e3779b97f4a7c15ull;
+  uint64_t hash = bytes.size() * kMultiplier;
+  size_t i = 0;
+  for (; i + 8 <= bytes.size(); i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes.data() + i, 8);
+    hash = (hash ^ word) * kMultiplier;
+    hash ^= hash >> 29;
+  }
+  uint64_t tail = 0;
+  if (i < bytes.size()) {
+    std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+  }
+  hash = (hash ^ tail) * kMultiplier;
+  return hash ^ (hash >> 32);
+}
+
+// Flattens a Document into the sections of a snapshot. Arrays and tables
+// are emitted once and shared by the entry that holds them and by the
+// index slot of their path.
+class Snapshot::Writer {
+ public:
+  std::vector<Record> values;
+  std::vector<Entry> entries;
+  std::vector<Path> paths;
+  std::vector<Slot> slots;
+  std::string strings;
+
+  void root(const std::vector<KeyValue>& top) {
+    entries.resize(top.size());
+    for (size_t i = 0; i < top.size(); ++i) {
+      Entry entry = makeEntry(top[i]);
+      entries[i] = entry;
+    }
+  }
+
+  void index(const PathIndex& index) {
+    size_t size = index.size() ? 16 : 0;
+    while (size && index.size() * 4 > size * 3) {
+      size *= 2;
+    }
+    slots.assign(size, Slot{0, kEmptySlot});
+    paths.reserve(index.size());
+
+    index.forEach([&](std::string_view path, const Value& value) {
+      uint64_t hash = hashBytes(path);
+      Path entry{addString(path), static_cast<uint32_t>(path.size()),
+                 record(value)};
+      size_t mask = slots.size() - 1;
+      size_t i = hash & mask;
+      while (slots[i].path != kEmptySlot) {
+        i = (i + 1) & mask;
+      }
+      slots[i] = {static_cast<uint32_t>(hash),
+                  static_cast<uint32_t>(paths.size())};
+      paths.push_back(entry);
+    });
+  }
+
+ private:
+  std::unordered_map<const char*, uint32_t> stringOffsets;
+  std::unordered_map<const void*, uint64_t> emitted;
+
+  // Keys and string values are interned, so equal strings usually share a
+  // pointer and are written once.
+  uint32_t addString(std::string_view text) {
+    auto found = stringOffsets.find(text.data());
+    if (found != stringOffsets.end() &&
+        std::string_view(strings).substr(found->second, text.size()) ==
+            text) {
+      return found->second;
+    }
+    uint32_t offset = static_cast<uint32_t>(strings.size());
+    strings.append(text.data(), text.size());
+    stringOffsets[text.data()] = offset;
+    return offset;
+  }
+
+  Entry makeEntry(const KeyValue& entry) {
+    Entry out{addString(entry.key), static_cast<uint32_t>(entry.key.size()),
+              record(entry.value)};
+    return out;
+  }
+
+  Record record(const Value& value) {
+    Record out{0, 0, static_cast<uint8_t>(value.kind()), {}};
+    switch (value.kind()) {
+      case Kind::String:
+        out.payload = addString(value.asString());
+        out.length = static_cast<uint32_t>(value.asString().size());
+        break;
+      case Kind::Integer: {
+        int64_t integer = value.asInteger();
+        std::memcpy(&out.payload, &integer, 8);
+        break;
+      }
+      case Kind::Float: {
+        double floating = value.asFloat();
+        std::memcpy(&out.payload, &floating, 8);
+        break;
+      }
+      case Kind::Bool:
+        out.payload = value.asBool();
+        break;
+      case Kind::Array: {
+        Span<const Value> items = value.asArray();
+        out.length = static_cast<uint32_t>(items.size());
+        auto found = emitted.find(items.begin());
+        if (found != emitted.end()) {
+          out.payload = found->second;
+          break;
+        }
+        // Items may hold arrays themselves, which append to `values`, so
+        // reserve the run first and fill it by index.
+        size_t first = values.size();
+        values.resize(first + items.size());
+        for (size_t i = 0; i < items.size(); ++i) {
+          Record item = record(items[i]);
+          values[first + i] = item;
+        }
+        out.payload = first;
+        if (!items.empty()) {
+          emitted.emplace(items.begin(), first);
+        }
+        break;
+      }
+      case Kind::Table: {
+        Span<const KeyValue> body = value.asTable();
+        out.length = static_cast<uint32_t>(body.size());
+        auto found = emitted.find(body.begin());
+        if (found != emitted.end()) {
+          out.payload = found->second;
+          break;
+        }
+        size_t first = entries.size();
+        entries.resize(first + body.size());
+        for (size_t i = 0; i < body.size(); ++i) {
+          Entry entry = makeEntry(body[i]);
+          entries[first + i] = entry;
+        }
+        out.payload = first;
+        if (!body.empty()) {
+          emitted.emplace(body.begin(), first);
+        }
+        break;
+      }
+      default:
+        break;
+    }
+    return out;
+  }
+};
+
+std::string Snapshot::serialize(const Document& document,
+                                std::string_view source, int64_t mtime) {
+  Writer writer;
+  writer.root(document.entries);
+  writer.index(document.index);
+
+  Header header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byteOrder = kByteOrder;
+  header.sourceHash = hashBytes(source);
+  header.sourceSize = source.size();
+  header.sourceMtime = mtime;
+  header.valueCount = writer.values.size();
+  header.entryCount = writer.entries.size();
+  header.rootCount = document.entries.size();
+  header.pathCount = writer.paths.size();
+  header.slotCount = writer.slots.size();
+  header.stringBytes = writer.strings.size();
+
+  std::string out;
+  out.reserve(sizeof(Header) + writer.values.size() * sizeof(Record) +
+              writer.entries.size() * sizeof(Entry) +
+              writer.paths.size() * sizeof(Path) +
+              writer.slots.size() * sizeof(Slot) +
+              align8(writer.strings.size()));
+  out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.append(reinterpret_cast<const char*>(writer.values.data()),
+             writer.values.size() * sizeof(Record));
+  out.append(reinterpret_cast<const char*>(writer.entries.data()),
+             writer.entries.size() * sizeof(Entry));
+  out.append(reinterpret_cast<const char*>(writer.paths.data()),
+             writer.paths.size() * sizeof(Path));
+  out.append(reinterpret_cast<const char*>(writer.slots.data()),
+             writer.slots.size() * sizeof(Slot));
+  out.append(writer.strings);
+  out.resize(align8(out.size()));
+  return out;
+}
+
+bool Snapshot::write(const Document& document, std::string_view source,
+                     int64_t mtime, const std::string& cachePath) {
+  return writeFile(serialize(document, source, mtime), cachePath);
+}
+
+std::shared_ptr<const Snapshot> Snapshot::open(const std::string& cachePath) {
+  return open(Source::map(cachePath));
+}
+
+std::shared_ptr<const Snapshot> Snapshot::open(
+    std::shared_ptr<const Source> bytes) {
+  if (!bytes) {
+    return nullptr;
+  }
+  std::string_view data = bytes->view();
+  if (data.size() < sizeof(Header) ||
+      reinterpret_cast<uintptr_t>(data.data()) % 8 != 0) {
+    return nullptr;
+  }
+  const Header* header = reinterpret_cast<const Header*>(data.data());
+  if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion || header->byteOrder != kByteOrder ||
+      (header->slotCount & (header->slotCount - 1)) != 0) {
+    return nullptr;
+  }
+
+  // Check the section sizes one at a time so a corrupt count cannot
+  // overflow the sum.
+  size_t remaining = data.size() - sizeof(Header);
+  auto take = [&](uint64_t count, size_t size) {
+    if (count > remaining / size) {
+      return false;
+    }
+    remaining -= count * size;
+    return true;
+  };
+  if (!take(header->valueCount, sizeof(Record)) ||
+      !take(header->entryCount, sizeof(Entry)) ||
+      !take(header->pathCount, sizeof(Path)) ||
+      !take(header->slotCount, sizeof(Slot)) ||
+      !take(header->stringBytes, 1) ||
+      header->rootCount > header->entryCount) {
+    return nullptr;
+  }
+
+  std::shared_ptr<Snapshot> snapshot(new Snapshot());
+  snapshot->storage = std::move(bytes);
+  snapshot->data = data;
+  snapshot->header = header;
+  const char* at = data.data() + sizeof(Header);
+  snapshot->values = reinterpret_cast<const Record*>(at);
+  at += header->valueCount * sizeof(Record);
+  snapshot->entries = reinterpret_cast<const Entry*>(at);
+  at += header->entryCount * sizeof(Entry);
+  snapshot->paths = reinterpret_cast<const Path*>(at);
+  at += header->pathCount * sizeof(Path);
+  snapshot->slots = reinterpret_cast<const Slot*>(at);
+  at += header->slotCount * sizeof(Slot);
+  snapshot->strings = at;
+  return snapshot;
+}
+
+std::shared_ptr<const Snapshot> Snapshot::load(const std::string& path,
+                                               const std::string& cachePath,
+                                               Validate validate) {
+  // Stat before reading, so an edit made while we parse leaves a cache
+  // that looks stale rather than one that looks current.
+  int64_t mtime = 0;
+  uint64_t size = 0;
+  bool stated = Source::stat(path, size, mtime);
+
+  if (validate == Validate::Mtime && stated) {
+    auto cached = open(cachePath);
+    if (cached && cached->isFreshFor(size, mtime)) {
+      return cached;
+    }
+  }
+
+  auto source = Source::map(path);
+  if (!source) {
+    std::cerr << "File " << path << " not found" << std::endl;
+    return nullptr;
+  }
+  if (validate == Validate::Content) {
+    auto cached = open(cachePath);
+    if (cached && cached->isFreshFor(source->view())) {
+      return cached;
+    }
+  }
+
+  Parser parser(source);
+  if (!parser.getError().empty()) {
+    return nullptr;
+  }
+  std::string bytes =
+      serialize(parser.getDocument(), source->view(), stated ? mtime : 0);
+  writeFile(bytes, cachePath);
+  return open(Source::copy(bytes));
+}
+
+bool Snapshot::isFreshFor(std::string_view source) const {
+  return header->sourceSize == source.size() &&
+         header->sourceHash == hashBytes(source);
+}
+
+bool Snapshot::isFreshFor(uint64_t size, int64_t mtime) const {
+  return header->sourceSize == size && header->sourceMtime == mtime &&
+         mtime != 0;
+}
+
+SnapshotValue Snapshot::find(std::string_view path) const {
+  if (header->slotCount == 0) {
+    return {};
+  }
+  uint64_t hash = hashBytes(path);
+  size_t mask = header->slotCount - 1;
+  for (size_t i = hash & mask, probes = 0; probes <= mask;
+       i = (i + 1) & mask, ++probes) {
+    const Slot& slot = slots[i];
+    if (slot.path == kEmptySlot) {
+      return {};
+    }
+    if (slot.hash != static_cast<uint32_t>(hash) ||
+        slot.path >= header->pathCount) {
+      continue;
+    }
+    const Path& entry = paths[slot.path];
+    if (entry.length == path.size() &&
+        uint64_t(entry.offset) + entry.length <= header->stringBytes &&
+        std::memcmp(strings + entry.offset, path.data(), path.size()) == 0) {
+      return make(entry.value);
+    }
+  }
+  return {};
+}
+
+SnapshotValue Snapshot::root() const {
+  Record record{0, static_cast<uint32_t>(header->rootCount),
+                static_cast<uint8_t>(Kind::Table), {}};
+  return make(record);
+}
+
+// Checks that the record's strings, items or entries lie inside the
+// snapshot; anything else reads as None.
+SnapshotValue Snapshot::make(const Record& record) const {
+  SnapshotValue value;
+  uint64_t end = record.payload + record.length;
+  bool inside = end >= record.payload;
+  switch (static_cast<Kind>(record.kind)) {
+    case Kind::String:
+      inside = inside && end <= header->stringBytes;
+      break;
+    case Kind::Array:
+      inside = inside && end <= header->valueCount;
+      break;
+    case Kind::Table:
+      inside = inside && end <= header->entryCount;
+      break;
+    case Kind::Integer:
+    case Kind::Float:
+    case Kind::Bool:
+      inside = true;
+      break;
+    default:
+      inside = false;
+      break;
+  }
+  if (inside) {
+    value.snapshot = this;
+    value.payload = record.payload;
+    value.length = record.length;
+    value.tag = static_cast<Kind>(record.kind);
+  }
+  return value;
+}
+
+std::string_view SnapshotValue::asString() const {
+  return {snapshot->strings + payload, length};
+}
+
+int64_t SnapshotValue::asInteger() const {
+  int64_t integer;
+  std::memcpy(&integer, &payload, 8);
+  return integer;
+}
+
+double SnapshotValue::asFloat() const {
+  double floating;
+  std::memcpy(&floating, &payload, 8);
+  return floating;
+}
+
+bool SnapshotValue::asBool() const { return payload != 0; }
+
+SnapshotValue SnapshotValue::operator[](size_t i) const {
+  return snapshot->make(snapshot->values[payload + i]);
+}
+
+std::string_view SnapshotValue::key(size_t i) const {
+  const Snapshot::Entry& entry = snapshot->entries[payload + i];
+  if (uint64_t(entry.keyOffset) + entry.keyLength >
+      snapshot->header->stringBytes) {
+    return {};
+  }
+  return {snapshot->strings + entry.keyOffset, entry.keyLength};
+}
+
+SnapshotValue SnapshotValue::value(size_t i) const {
+  return snapshot->make(snapshot->entries[payload + i].value);
+}
@@ -0,0 +1,179 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "ast.hpp"
+#include "document.hpp"
+#include "source.hpp"
+
+namespace GTOML {
+// Hashes `bytes` eight at a time. Stable across runs and builds, unlike
+// std::hash, so it can key data written to disk.
+uint64_t hashBytes(std::string_view bytes);
+
+class Snapshot;
+
+// A value stored in a Snapshot. Strings, array items and table entries are
+// read straight out of the snapshot's bytes, so a SnapshotValue is only
+// valid while its Snapshot is alive. Records that point outside the
+// snapshot read as None.
+class SnapshotValue {
+ public:
+  SnapshotValue() = default;
+
+  Kind kind() const { return tag; }
+  bool isNone() const { return tag == Kind::None; }
+
+  std::string_view asString() const;
+  int64_t asInteger() const;
+  double asFloat() const;
+  bool asBool() const;
+
+  // Items of an array or entries of a table.
+  size_t size() const { return length; }
+  SnapshotValue operator[](size_t i) const;  // array item
+  std::string_view key(size_t i) const;      // table entry key
+  SnapshotValue value(size_t i) const;       // table entry value
+
+  // int64_t, double (integers widen), bool or std::string_view; nullopt on a
+  // kind mismatch, as Value::as.
+  template <typename T>
+  std::optional<T> as() const;
+
+ private:
+  friend class Snapshot;
+
+  const Snapshot* snapshot = nullptr;
+  uint64_t payload = 0;
+  uint32_t length = 0;
+  Kind tag = Kind::None;
+};
+
+// How Snapshot::load decides whether a cache file is still current.
+enum class Validate {
+  Content,  // hash the TOML file and compare it to the recorded hash
+  Mtime,    // compare size and modification time without reading the file
+};
+
+// A parsed document in a compact, position-independent binary form. A
+// snapshot is written once after a text parse and then mapped on later
+// starts, where lookups are served from the mapped pages without running
+// the Lexer or Parser. Offsets inside the file are relative to its start,
+// and paths are found through a hash table stored in the file.
+//
+// The file records the hash, size and modification time of the TOML text it
+// was built from. Snapshots use the byte order of the machine that wrote
+// them; a file from another byte order or format version is rejected.
+class Snapshot {
+ public:
+  // Returns the snapshot cached at `cachePath` if it is current for the TOML
+  // file at `path`. Otherwise parses the file, rewrites the cache and
+  // returns a snapshot of the new document. Returns nullptr when the TOML
+  // file cannot be read or does not parse; the error is printed as Parser
+  // prints it. A cache that cannot be written is not an error.
+  static std::shared_ptr<const Snapshot> load(const std::string& path,
+                                              const std::string& cachePath,
+                                              Validate validate =
+                                                  Validate::Content);
+
+  // Maps a snapshot file. Returns nullptr if it is missing or not a valid
+  // snapshot.
+  static std::shared_ptr<const Snapshot> open(const std::string& cachePath);
+  // Wraps snapshot bytes already in memory, e.g. from serialize().
+  static std::shared_ptr<const Snapshot> open(
+      std::shared_ptr<const Source> bytes);
+
+  // The snapshot bytes of `document`, which was parsed from `source`.
+  // `mtime` is the source file's modification time as Source::stat()
+  // reports it, or 0.
+  static std::string serialize(const Document& document,
+                               std::string_view source, int64_t mtime = 0);
+  // Writes serialize() to `cachePath` through a temporary file and a
+  // rename, so concurrent readers never map a partial snapshot.
+  static bool write(const Document& document, std::string_view source,
+                    int64_t mtime, const std::string& cachePath);
+
+  Snapshot(const Snapshot&) = delete;
+  Snapshot& operator=(const Snapshot&) = delete;
+
+  // True if the snapshot was built from exactly `source`.
+  bool isFreshFor(std::string_view source) const;
+  // True if the snapshot records this source size and modification time.
+  bool isFreshFor(uint64_t size, int64_t mtime) const;
+
+  // The value at a full dotted path, as Document::find; None if missing.
+  SnapshotValue find(std::string_view path) const;
+  template <typename T>
+  std::optional<T> get(std::string_view path) const {
+    return find(path).as<T>();
+  }
+
+  // The top-level keys and tables in source order, as a table.
+  SnapshotValue root() const;
+
+  size_t bytes() const { return data.size(); }
+
+ private:
+  friend class SnapshotValue;
+
+  // The file layout, defined in snapshot.cpp.
+  struct Header;
+  struct Record;
+  struct Entry;
+  struct Path;
+  struct Slot;
+  class Writer;
+
+  Snapshot() = default;
+
+  SnapshotValue make(const Record& record) const;
+
+  std::shared_ptr<const Source> storage;
+  std::string_view data;
+  const Header* header = nullptr;
+  const Record* values = nullptr;
+  const Entry* entries = nullptr;
+  const Path* paths = nullptr;
+  const Slot* slots = nullptr;
+  const char* strings = nullptr;
+};
+
+template <>
+inline std::optional<int64_t> SnapshotValue::as<int64_t>() const {
+  if (tag != Kind::Integer) {
+    return std::nullopt;
+  }
+  return asInteger();
+}
+
+template <>
+inline std::optional<double> SnapshotValue::as<double>() const {
+  if (tag == Kind::Integer) {
+    return static_cast<double>(asInteger());
+  }
+  if (tag != Kind::Float) {
+    return std::nullopt;
+  }
+  return asFloat();
+}
+
+template <>
+inline std::optional<bool> SnapshotValue::as<bool>() const {
+  if (tag != Kind::Bool) {
+    return std::nullopt;
+  }
+  return asBool();
+}
+
+template <>
+inline std::optional<std::string_view> SnapshotValue::as<std::string_view>()
+    const {
+  if (tag != Kind::String) {
+    return std::nullopt;
+  }
+  return asString();
+}
+}  // namespace GTOML
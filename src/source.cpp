@@ -0,0 +1,134 @@
+#include "source.hpp"
+
+#include <sys/stat.h>
+
+#include <fstream>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace GTOML;
+
+namespace {
+// Directories, devices and pipes have no size to read up front; opening a
+// directory with fstream even succeeds on some platforms.
+bool isRegularFile(const struct ::stat& info) {
+  return (info.st_mode & S_IFMT) == S_IFREG;
+}
+}  // namespace
+
+std::shared_ptr<const Source> Source::read(const std::string& path) {
+  struct ::stat info;
+  if (::stat(path.c_str(), &info) != 0 || !isRegularFile(info)) {
+    return nullptr;
+  }
+  std::fstream file(path.data(), std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    return nullptr;
+  }
+
+  std::shared_ptr<Source> source(new Source());
+  file.seekg(0, std::ios::end);
+  std::streamoff size = file.tellg();
+  if (size < 0) {
+    return nullptr;
+  }
+  source->owned.resize(static_cast<size_t>(size));
+  file.seekg(0, std::ios::beg);
+  file.read(&source->owned[0], source->owned.size());
+  if (static_cast<size_t>(file.gcount()) != source->owned.size()) {
+    return nullptr;
+  }
+  file.close();
+
+  source->data = source->owned.data();
+  source->size = source->owned.size();
+  return source;
+}
+
+std::shared_ptr<const Source> Source::copy(std::string_view text) {
+  std::shared_ptr<Source> source(new Source());
+  source->owned.assign(text.data(), text.size());
+  source->data = source->owned.data();
+  source->size = source->owned.size();
+  return source;
+}
+
+std::shared_ptr<const Source> Source::borrow(std::string_view text) {
+  std::shared_ptr<Source> source(new Source());
+  source->data = text.data();
+  source->size = text.size();
+  return source;
+}
+
+bool Source::stat(const std::string& path, uint64_t& size, int64_t& mtime) {
+  struct ::stat info;
+  if (::stat(path.c_str(), &info) != 0) {
+    return false;
+  }
+  size = static_cast<uint64_t>(info.st_size);
+  // Seconds alone would miss a rewrite within the same second.
+#if defined(_WIN32)
+  mtime = static_cast<int64_t>(info.st_mtime) * 1000000000;
+#elif defined(__APPLE__)
+  mtime = static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 +
+          info.st_mtimespec.tv_nsec;
+#else
+  mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 +
+          info.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+#if defined(_WIN32)
+
+std::shared_ptr<const Source> Source::map(const std::string& path) {
+  return read(path);
+}
+
+Source::~Source() {}
+
+#else
+
+std::shared_ptr<const Source> Source::map(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat info;
+  if (::fstat(fd, &info) != 0 || !isRegularFile(info)) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  std::shared_ptr<Source> source(new Source());
+  if (info.st_size == 0) {
+    // mmap rejects zero-length mappings; an empty view is all we need.
+    ::close(fd);
+    return source;
+  }
+
+  void* pages = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (pages == MAP_FAILED) {
+    return read(path);
+  }
+  ::madvise(pages, info.st_size, MADV_SEQUENTIAL);
+
+  source->data = static_cast<const char*>(pages);
+  source->size = info.st_size;
+  source->mapped = true;
+  return source;
+}
+
+Source::~Source() {
+  if (mapped) {
+    ::munmap(const_cast<char*>(data), size);
+  }
+}
+
+#endif
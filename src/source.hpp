@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace GTOML {
+// How the bytes of a TOML file are brought into memory.
+enum class Input {
+  Read,  // copy the file into an owned buffer
+  Map,   // map the file read-only and scan the pages in place
+};
+
+// The bytes of a TOML document. Tokens and AST strings are views into
+// this buffer, so it has to outlive every Lexer and Parser built on it.
+class Source {
+ public:
+  // Both return nullptr when the file cannot be opened or read in full, or
+  // is not a regular file, e.g. a directory.
+  static std::shared_ptr<const Source> read(const std::string& path);
+  static std::shared_ptr<const Source> map(const std::string& path);
+
+  // In-memory input that never touches the filesystem. copy() keeps its own
+  // copy of the text; borrow() requires the caller to keep the text alive
+  // (string literals, embedded resources) for as long as the parser.
+  static std::shared_ptr<const Source> copy(std::string_view text);
+  static std::shared_ptr<const Source> borrow(std::string_view text);
+
+  // The size and modification time of the file at `path`, the time in
+  // nanoseconds since the epoch (whole seconds where the platform has no
+  // finer time). Returns false if it cannot be stat'ed.
+  static bool stat(const std::string& path, uint64_t& size, int64_t& mtime);
+
+  Source(const Source&) = delete;
+  Source& operator=(const Source&) = delete;
+  ~Source();
+
+  std::string_view view() const { return {data, size}; }
+  bool isMapped() const { return mapped; }
+
+ private:
+  Source() = default;
+
+  const char* data = nullptr;
+  size_t size = 0;
+  bool mapped = false;
+  std::string owned;
+};
+}  // namespace GTOML
@@ -0,0 +1,114 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+using namespace GTOML;
+
+namespace {
+// Phase names are set by the library or by the caller's Scopes; escape
+// them anyway so that the trace is always valid JSON.
+void appendJsonString(std::string& out, const char* text) {
+  out += '"';
+  for (; *text; ++text) {
+    unsigned char c = *text;
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += static_cast<char>(c);
+    } else if (c < 0x20) {
+      char escape[8];
+      std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+      out += escape;
+    } else {
+      out += static_cast<char>(c);
+    }
+  }
+  out += '"';
+}
+}  // namespace
+
+uint64_t Stats::peakRss() {
+#if defined(_WIN32)
+  return 0;
+#else
+  rusage usage;
+  if (::getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return usage.ru_maxrss;  // bytes
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;  // KiB
+#endif
+#endif
+}
+
+void Stats::record(PhaseStats phase) {
+  phase.peakRss = peakRss();
+  std::thread::id self = std::this_thread::get_id();
+  std::lock_guard<std::mutex> guard(lock);
+  auto known = std::find(threads.begin(), threads.end(), self);
+  phase.thread = static_cast<uint32_t>(known - threads.begin());
+  if (known == threads.end()) {
+    threads.push_back(self);
+  }
+  recorded.push_back(phase);
+}
+
+std::vector<PhaseStats> Stats::phases() const {
+  std::lock_guard<std::mutex> guard(lock);
+  return recorded;
+}
+
+PhaseStats Stats::total(const char* name) const {
+  PhaseStats sum{name, 0, 0, 0};
+  std::string wanted(name);
+  std::lock_guard<std::mutex> guard(lock);
+  bool first = true;
+  for (const auto& phase : recorded) {
+    if (wanted != phase.name) {
+      continue;
+    }
+    sum.startNs = first ? phase.startNs : std::min(sum.startNs, phase.startNs);
+    first = false;
+    sum.durationNs += phase.durationNs;
+    sum.tokens += phase.tokens;
+    sum.nodes += phase.nodes;
+    sum.bytes += phase.bytes;
+    sum.items += phase.items;
+    sum.peakRss = std::max(sum.peakRss, phase.peakRss);
+  }
+  return sum;
+}
+
+std::string Stats::chromeTrace(int pid) const {
+  std::vector<PhaseStats> all = phases();
+  std::string out = "{\"traceEvents\":[";
+  char number[160];
+  for (size_t i = 0; i < all.size(); ++i) {
+    const PhaseStats& phase = all[i];
+    out += i ? ",\n{\"name\":" : "\n{\"name\":";
+    appendJsonString(out, phase.name);
+    std::snprintf(number, sizeof(number),
+                  ",\"cat\":\"gtoml\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                  "\"pid\":%d,\"tid\":%u,",
+                  phase.startNs / 1000.0, phase.durationNs / 1000.0, pid,
+                  phase.thread);
+    out += number;
+    std::snprintf(number, sizeof(number),
+                  "\"args\":{\"tokens\":%llu,\"nodes\":%llu,\"bytes\":%llu,"
+                  "\"items\":%llu,\"peak_rss\":%llu}}",
+                  (unsigned long long)phase.tokens,
+                  (unsigned long long)phase.nodes,
+                  (unsigned long long)phase.bytes,
+                  (unsigned long long)phase.items,
+                  (unsigned long long)phase.peakRss);
+    out += number;
+  }
+  out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return out;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace GTOML {
+// One timed phase of loading a document, such as "read" or "parse".
+struct PhaseStats {
+  const char* name;
+  uint32_t thread;      // 0 for the first thread that recorded a phase
+  int64_t startNs;      // on the steady clock
+  int64_t durationNs;
+  uint64_t tokens = 0;  // tokens lexed
+  uint64_t nodes = 0;   // values built: keys, tables and array items
+  uint64_t bytes = 0;   // heap bytes the document grew by
+  uint64_t items = 0;   // anything else counted: input bytes, lookups
+  uint64_t peakRss = 0; // the process's peak resident bytes at the end
+};
+
+// Optional instrumentation of document loading. Pass a Stats to a Parser
+// (or to parse()) and it records a PhaseStats for each phase it runs:
+//
+//   read / map   bringing the file into memory (items: its bytes)
+//   lex          lexing every token up front, only with splitLexing
+//   parse        lexing and building the document; with several threads,
+//                the whole parallel parse
+//   section      one section of a parallel parse or of an edit, on the
+//                thread that parsed it
+//   merge        joining the sections of a parallel parse
+//   edit         a whole applyEdit()
+//
+// Lookups and other work of the caller can be recorded as phases of their
+// own with Scope. Without a Stats, the parser only checks a null pointer
+// at the start and end of each phase; nothing is counted per token or per
+// value. Any number of threads may record into one Stats.
+class Stats {
+ public:
+  // Records the phase `name` from construction until end() or destruction.
+  // A null `stats` records nothing. `name` must outlive the Stats, e.g. a
+  // string literal.
+  class Scope {
+   public:
+    Scope(Stats* stats, const char* name);
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    ~Scope();
+
+    // Stops the clock; counters may still be set until destruction.
+    void end();
+    bool enabled() const { return stats != nullptr; }
+
+    uint64_t tokens = 0;
+    uint64_t nodes = 0;
+    uint64_t bytes = 0;
+    uint64_t items = 0;
+
+   private:
+    Stats* stats;
+    const char* name;
+    int64_t startNs = 0;
+    int64_t endNs = 0;
+  };
+
+  // Lex the whole source before parsing it, so that "lex" and "parse" are
+  // timed apart. Lexing normally streams tokens into the parser, and then
+  // "parse" includes it; splitting keeps every token in memory meanwhile.
+  bool splitLexing = false;
+
+  // Every phase recorded so far, in the order they ended.
+  std::vector<PhaseStats> phases() const;
+  // The phases called `name` added together: total duration and counts,
+  // the earliest start and the highest peakRss.
+  PhaseStats total(const char* name) const;
+
+  // The phases as Chrome trace events ("ph": "X"), loadable in
+  // chrome://tracing or Perfetto. Timestamps are microseconds on the
+  // steady clock, so they line up with other traces taken on it; `pid` is
+  // the process id to file the events under.
+  std::string chromeTrace(int pid = 1) const;
+
+  static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+  // The process's peak resident set size, or 0 where it is not known.
+  static uint64_t peakRss();
+
+ private:
+  void record(PhaseStats phase);
+
+  mutable std::mutex lock;
+  std::vector<PhaseStats> recorded;
+  std::vector<std::thread::id> threads;  // index is PhaseStats::thread
+};
+
+inline Stats::Scope::Scope(Stats* stats, const char* name)
+    : stats(stats), name(name) {
+  if (stats) {
+    startNs = nowNs();
+  }
+}
+
+inline Stats::Scope::~Scope() {
+  if (stats) {
+    end();
+    PhaseStats phase{name, 0, startNs, endNs - startNs};
+    phase.tokens = tokens;
+    phase.nodes = nodes;
+    phase.bytes = bytes;
+    phase.items = items;
+    stats->record(phase);
+  }
+}
+
+inline void Stats::Scope::end() {
+  if (stats && endNs == 0) {
+    endNs = nowNs();
+  }
+}
+}  // namespace GTOML
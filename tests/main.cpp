@@ -1,9 +1,161 @@
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <thread>
+#include <vector>
+#include "../src/batch.hpp"
+#include "../src/bind.hpp"
+#include "../src/emit.hpp"
+#include "../src/events.hpp"
+#include "../src/lazy.hpp"
 #include "../src/parser.hpp"
+#include "../src/reload.hpp"
+#include "../src/snapshot.hpp"
 
 
 using namespace GTOML;
 
+struct Package {
+    std::string name;
+    double version = 0;
+    bool is_experimental = false;
+    std::vector<std::string> files;
+    std::optional<int64_t> downloads;
+};
+
+struct Tls {
+    std::string cert;
+    uint16_t port = 443;
+};
+
+struct Project {
+    Package package;
+    Tls tls;
+    std::vector<std::vector<int>> grid;
+};
+
+// Records the events of a parse as text, and stops at key `stop`.
+struct EventLog : Handler {
+    std::string log;
+    std::string_view stop;
+
+    bool onTableBegin(std::string_view name) override {
+        log += "[" + std::string(name) + " ";
+        return true;
+    }
+    bool onTableEnd() override {
+        log += "] ";
+        return true;
+    }
+    bool onKey(std::string_view key) override {
+        log += std::string(key) + "=";
+        return key != stop;
+    }
+    bool onScalar(const Value& value) override {
+        log += value.kind() == Kind::String ? std::string(value.asString())
+                                            : std::to_string(value.asInteger());
+        log += " ";
+        return true;
+    }
+    bool onArrayBegin() override {
+        log += "( ";
+        return true;
+    }
+    bool onArrayEnd() override {
+        log += ") ";
+        return true;
+    }
+};
+
+// Whether two parsed values are the same, comparing floats bit for bit so
+// that nan and -0.0 count.
+static bool sameValue(const Value& a, const Value& b) {
+    if (a.kind() != b.kind()) {
+        return false;
+    }
+    switch (a.kind()) {
+        case Kind::String:
+            return a.asString() == b.asString();
+        case Kind::Integer:
+            return a.asInteger() == b.asInteger();
+        case Kind::Float: {
+            double x = a.asFloat(), y = b.asFloat();
+            return std::memcmp(&x, &y, sizeof(x)) == 0;
+        }
+        case Kind::Bool:
+            return a.asBool() == b.asBool();
+        case Kind::Array: {
+            if (a.asArray().size() != b.asArray().size()) {
+                return false;
+            }
+            for (size_t i = 0; i < a.asArray().size(); ++i) {
+                if (!sameValue(a.asArray()[i], b.asArray()[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case Kind::Table: {
+            if (a.asTable().size() != b.asTable().size()) {
+                return false;
+            }
+            for (size_t i = 0; i < a.asTable().size(); ++i) {
+                if (a.asTable()[i].key != b.asTable()[i].key ||
+                    !sameValue(a.asTable()[i].value, b.asTable()[i].value)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            return true;
+    }
+}
+
+static bool sameDocument(const Document& a, const Document& b) {
+    if (a.entries.size() != b.entries.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.entries.size(); ++i) {
+        if (a.entries[i].key != b.entries[i].key ||
+            !sameValue(a.entries[i].value, b.entries[i].value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace GTOML {
+template <>
+struct Binding<Package> {
+    static void describe(Fields<Package>& fields) {
+        fields.required("name", &Package::name)
+            .required("version", &Package::version)
+            .required("is_experimental", &Package::is_experimental)
+            .required("files", &Package::files)
+            .optional("downloads", &Package::downloads);
+    }
+};
+template <>
+struct Binding<Tls> {
+    static void describe(Fields<Tls>& fields) {
+        fields.required("cert", &Tls::cert).optional("port", &Tls::port);
+    }
+};
+template <>
+struct Binding<Project> {
+    static void describe(Fields<Project>& fields) {
+        fields.required("package", &Project::package)
+            .optional("tls", &Project::tls)
+            .optional("grid", &Project::grid);
+    }
+};
+}  // namespace GTOML
+
 int main() {
     Parser toml("tests/test.toml");
     if (toml.Parse()) {
@@ -17,10 +169,543 @@ int main() {
         auto is_experimental = toml.getTableValue("package.is_experimental");
         std::cout << is_experimental << std::endl;
 
+        auto version = toml.get<double>("package.version");
+        auto files = toml.get<ArrayView>("package.files");
+        if (!version || *version != 0.1 || !files || files->size() != 5 ||
+            toml.get<int64_t>("package.name") ||
+            toml.get<bool>("package.missing")) {
+            std::cerr << "Typed lookups returned wrong results." << std::endl;
+            return 1;
+        }
+
+        // The repeated header is interned: 11 keys and strings, 9 of them
+        // distinct, are stored once each.
+        const InternPool& pool = toml.getDocument().strings;
+        if (pool.requests() != 11 || pool.size() != 9 ||
+            pool.find("src/libgtoml.hpp") != (*files)[4].asString()) {
+            std::cerr << "Repeated strings were not interned." << std::endl;
+            return 1;
+        }
 
     } else {
         std::cerr << "Failed to parse TOML file." << std::endl;
     }
 
+    const char blob[] =
+        "title = \"in memory # not a comment\" # a comment\n"
+        "[server]\n"
+        "port = 8080\n";
+    Parser buffer(blob, sizeof(blob) - 1);
+    if (buffer.Parse()) {
+        std::cout << buffer.getValueByKey("title") << std::endl;
+        std::cout << buffer.getTableValue("server.port") << std::endl;
+        if (buffer.get<int64_t>("server.port").value_or(0) != 8080) {
+            std::cerr << "Typed lookup of server.port failed." << std::endl;
+            return 1;
+        }
+
+        KeyHandle port = buffer.compile("server.port");
+        const char edited[] = "[server]\nport = 9090\n";
+        if (buffer.get<int64_t>(port) != 8080 ||
+            !buffer.reparse(Source::copy(edited)) ||
+            buffer.get<int64_t>(port) != 9090 ||
+            buffer.get<std::string_view>("title")) {
+            std::cerr << "Key handle was not revalidated after reparse."
+                      << std::endl;
+            return 1;
+        }
+    } else {
+        std::cerr << "Failed to parse TOML buffer." << std::endl;
+    }
+
+    const char numbers[] =
+        "[numbers]\n"
+        "big = 9_007_199_254_740_993\n"
+        "negative = -42\n"
+        "hex = 0xdead_beef\n"
+        "octal = 0o755\n"
+        "binary = 0b1101\n"
+        "exponent = 6.02e23\n"
+        "plain_exponent = 1e3\n"
+        "infinity = -inf\n"
+        "precise = 0.1234567890123\n";
+    Parser numeric(numbers, sizeof(numbers) - 1);
+    if (!numeric.Parse() ||
+        numeric.get<int64_t>("numbers.big") != 9007199254740993 ||
+        numeric.get<int64_t>("numbers.negative") != -42 ||
+        numeric.get<int64_t>("numbers.hex") != 0xdeadbeef ||
+        numeric.get<int64_t>("numbers.octal") != 0755 ||
+        numeric.get<int64_t>("numbers.binary") != 13 ||
+        numeric.get<double>("numbers.exponent") != 6.02e23 ||
+        numeric.get<double>("numbers.plain_exponent") != 1e3 ||
+        numeric.get<double>("numbers.infinity") != -HUGE_VAL ||
+        numeric.getTableValue("numbers.precise") != "0.1234567890123") {
+        std::cerr << "Numeric values were not parsed exactly." << std::endl;
+        return 1;
+    }
+
+    // Malformed numbers are reported, including leading zeros and a '.'
+    // without digits after it, which from_chars alone would accept.
+    const char* malformedNumbers[] = {"007", "-01", "+-1", "1__0", "0x",
+                                      "1.", "1.e3", "01.5", "1e", "1._5"};
+    for (const char* number : malformedNumbers) {
+        Parser malformed(Source::copy("x = " + std::string(number) + "\n"));
+        if (malformed.getError().empty()) {
+            std::cerr << "Malformed number " << number << " was accepted."
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    const char sections[] =
+        "title = \"sections\"\n"
+        "[a]\nlist = [\n    [1, 2],\n    [3],\n]\n"
+        "[b]\nname = \"[not a header]\" # [nor this]\n"
+        "[a]\nlist = 0\n"
+        "[c]\nport = 1\n";
+    auto text = Source::copy(std::string_view(sections, sizeof(sections) - 1));
+    Parser sequential(text);
+    Parser parallel(text, 4);
+    if (!parallel.Parse() ||
+        parallel.getDocument().entries.size() !=
+            sequential.getDocument().entries.size() ||
+        parallel.getDocument().index.size() !=
+            sequential.getDocument().index.size() ||
+        parallel.getDocument().index.shadowed() !=
+            sequential.getDocument().index.shadowed() ||
+        !parallel.get<ArrayView>("a.list") ||
+        parallel.get<std::string_view>("b.name") != "[not a header]" ||
+        parallel.get<int64_t>("c.port") != 1) {
+        std::cerr << "Parallel parse differs from the sequential one."
+                  << std::endl;
+        return 1;
+    }
+
+    // Only real '=' tokens make the next '[' an array: one ending a comment
+    // does not, and one followed by a comment and a newline still does.
+    std::string_view commented =
+        "x = [1] # total =\n[a]\nk = 1 # default =\n[b]\nv = # list\n[2]\n";
+    for (simd::Backend backend : {simd::Backend::Scalar, simd::Backend::SSE2,
+                                  simd::Backend::AVX2}) {
+        simd::setBackend(backend);
+        std::vector<size_t> headers = Lexer::findTableHeaders(commented);
+        if (headers != std::vector<size_t>{commented.find("[a]"),
+                                           commented.find("[b]")}) {
+            std::cerr << "Table headers after a comment ending in '=' were"
+                      << " missed with " << simd::backendName(backend)
+                      << std::endl;
+            return 1;
+        }
+    }
+    simd::setBackend(simd::bestBackend());
+
+    // Stats record every phase with what it produced; a caller's own
+    // phases go in beside them.
+    Stats stats;
+    Parser measured("tests/test.toml", Input::Read, 1, &stats);
+    {
+        Stats::Scope lookup(&stats, "lookup");
+        lookup.items = measured.get<double>("package.version") ? 1 : 0;
+    }
+    Stats split;
+    split.splitLexing = true;
+    Parser lexedFirst(text, 1, &split);
+    Stats threaded;
+    Parser spread(text, 4, &threaded);
+    std::vector<PhaseStats> phases = stats.phases();
+    PhaseStats parsePhase = stats.total("parse");
+    std::string trace = threaded.chromeTrace();
+    if (phases.size() != 3 || std::strcmp(phases[0].name, "read") != 0 ||
+        phases[0].items != 192 || parsePhase.nodes != 10 ||
+        parsePhase.tokens == 0 || parsePhase.bytes == 0 ||
+        parsePhase.startNs < phases[0].startNs ||
+        stats.total("lookup").items != 1 ||
+        split.total("lex").tokens == 0 || split.total("parse").tokens != 0 ||
+        split.total("parse").nodes != threaded.total("parse").nodes ||
+        threaded.total("merge").items < 2 ||
+        threaded.total("section").nodes != threaded.total("parse").nodes ||
+        trace.find("{\"traceEvents\":[") != 0 ||
+        trace.find("\"name\":\"merge\",\"cat\":\"gtoml\",\"ph\":\"X\"") ==
+            std::string::npos) {
+        std::cerr << "Stats did not record the phases:\n"
+                  << stats.chromeTrace() << trace << std::endl;
+        return 1;
+    }
+
+    // A table defined twice within one section of a parallel parse still
+    // counts as shadowed, so an edit to it falls back to a full parse.
+    std::string twice = "[a]\nx = 1\n[a]\nx = 2\n";
+    for (int i = 0; i < 200; ++i) {
+        twice += "[filler_" + std::to_string(i) + "]\nv = 1\n";
+    }
+    Parser twiceParallel(Source::copy(twice), 4);
+    size_t shadowedParallel = twiceParallel.getDocument().index.shadowed();
+    twice.replace(twice.find('x'), 1, "y");
+    if (shadowedParallel != 2 ||
+        !twiceParallel.applyEdit(Source::copy(twice), 4, 1, 1) ||
+        twiceParallel.get<int64_t>("a.x") != 2 ||
+        twiceParallel.get<int64_t>("a.y") != 1) {
+        std::cerr << "Editing after a parallel parse lost shadowed keys."
+                  << std::endl;
+        return 1;
+    }
+
+    // Change a value, then comment out a header so its keys move up.
+    std::string config =
+        "name = \"app\"\n[a]\nport = 1\n[b]\nhost = \"h\"\n";
+    Parser editor(Source::copy(config));
+    KeyHandle aPort = editor.compile("a.port");
+    size_t at = config.find("1\n");
+    config.replace(at, 1, "10");
+    bool changed = editor.applyEdit(Source::copy(config), at, 1, 2) &&
+                   editor.get<int64_t>(aPort) == 10;
+    at = config.find("[b]");
+    config.insert(at, "#");
+    bool moved = editor.applyEdit(Source::copy(config), at, 0, 1);
+    if (!changed || !moved || editor.get<std::string_view>("b.host") ||
+        editor.get<std::string_view>("a.host") != "h" ||
+        editor.get<std::string_view>("name") != "app" ||
+        editor.getDocument().entries.size() != 2 ||
+        editor.getDocument().index.size() != 4) {
+        std::cerr << "Incremental edit differs from a full parse."
+                  << std::endl;
+        return 1;
+    }
+
+    // Snapshots stay as they were while the parser moves on, and can be
+    // read from several threads at once.
+    std::string shared = "[s]\nv = 1\n";
+    Parser owner(Source::copy(shared));
+    std::shared_ptr<const Document> v1 = owner.snapshot();
+    shared.replace(shared.find('1'), 1, "2");
+    owner.applyEdit(Source::copy(shared), shared.find('2'), 1, 1);
+    std::shared_ptr<const Document> v2 = owner.snapshot();
+    owner.reparse(Source::copy("[s]\nv = 3\n"));
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&] {
+            for (int i = 0; i < 1000; ++i) {
+                wrong += v1->get<int64_t>("s.v") != 1;
+                wrong += v2->get<int64_t>("s.v") != 2;
+            }
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    std::string parseError;
+    auto standalone = parse(Source::copy("[t]\nw = 4\n"));
+    if (wrong != 0 || owner.get<int64_t>("s.v") != 3 || !standalone ||
+        standalone->get<int64_t>("t.w") != 4 ||
+        parse(Source::copy("[t\n"), &parseError) || parseError.empty()) {
+        std::cerr << "Document snapshots changed after parsing." << std::endl;
+        return 1;
+    }
+
+    // Only the tables a lookup needs are parsed; the broken one never is.
+    LazyDocument lazy(Source::copy(
+        "title = \"lazy\"\n[a]\nport = 1\n[a.b]\nc = 2\n"
+        "[broken]\nx = = 1\n[a]\nhost = \"h\"\n[d]\nport = 4\n"));
+    if (lazy.tableCount() != 5 || lazy.parsedCount() != 0 ||
+        lazy.get<std::string_view>("title") != "lazy" ||
+        lazy.get<int64_t>("d.port") != 4 || lazy.parsedCount() != 1 ||
+        lazy.get<int64_t>("a.b.c") != 2 ||
+        lazy.get<std::string_view>("a.host") != "h" ||
+        lazy.get<int64_t>("a.port") != 1 || lazy.find("a.missing") ||
+        lazy.parsedCount() != 4 || !lazy.getError().empty()) {
+        std::cerr << "Lazy lookups differ from an eager parse." << std::endl;
+        return 1;
+    }
+
+    // A comment ending in '=' does not hide the next table from lookups.
+    auto afterComment = Source::copy("[a]\nx = 1 # default =\n[b]\nk = 2\n");
+    LazyDocument lazyAfterComment(afterComment);
+    Parser eagerAfterComment(afterComment);
+    if (eagerAfterComment.get<int64_t>("b.k") != 2 ||
+        lazyAfterComment.get<int64_t>("b.k") != 2 ||
+        lazyAfterComment.tableCount() != 2) {
+        std::cerr << "Lazy lookups missed a table after a comment."
+                  << std::endl;
+        return 1;
+    }
+
+    // Emitted TOML parses back to the same document, and emitting that
+    // again gives the same bytes.
+    Emitter emitter;
+    emitter.document(toml.getDocument());
+    Parser reread(Source::copy(emitter.view()));
+    std::string emitted(emitter.view());
+    emitter.clear();
+    emitter.document(reread.getDocument());
+    if (!reread.getError().empty() ||
+        !sameDocument(toml.getDocument(), reread.getDocument()) ||
+        emitter.view() != emitted) {
+        std::cerr << "Emitted test.toml does not read back:\n" << emitted
+                  << std::endl;
+        return 1;
+    }
+    emitter.clear();
+    emitter.key("min").integer(INT64_MIN).key("tenth").floating(0.1);
+    emitter.key("tiny").floating(5e-324).key("nan_").floating(-NAN);
+    emitter.key("text").string("say \"hi\"\n\\ \x01 [x] # y");
+    emitter.key("empty").beginArray().endArray();
+    emitter.table("t.u").key("grid").beginArray();
+    emitter.beginArray().integer(1).boolean(false).endArray();
+    emitter.beginArray().endArray().string("").endArray();
+    Parser generated(Source::copy(emitter.view()));
+    emitted = std::string(emitter.view());
+    emitter.clear();
+    emitter.document(generated.getDocument());
+    if (!emitter.ok() || !generated.getError().empty() ||
+        generated.get<int64_t>("min") != INT64_MIN ||
+        generated.get<double>("tenth") != 0.1 ||
+        generated.get<double>("tiny") != 5e-324 ||
+        !std::signbit(*generated.get<double>("nan_")) ||
+        generated.get<std::string_view>("text") !=
+            "say \"hi\"\n\\ \x01 [x] # y" ||
+        generated.get<ArrayView>("empty")->size() != 0 ||
+        generated.get<ArrayView>("t.u.grid")->size() != 3 ||
+        emitter.view() != emitted) {
+        std::cerr << "Built TOML does not read back:\n" << emitted
+                  << std::endl;
+        return 1;
+    }
+    // Escapes are decoded; an unknown one is an error.
+    Parser escaped(Source::borrow(
+        "s = \"tab\\there \\u00e9 \\U0001F600 \\\"q\\\"\"\n"));
+    Parser unknownEscape(Source::borrow("s = \"\\q\"\n"));
+    Parser surrogate(Source::borrow("s = \"\\uD800\"\n"));
+    if (escaped.get<std::string_view>("s") !=
+            "tab\there \u00e9 \U0001F600 \"q\"" ||
+        unknownEscape.getError() != "Invalid escape in string: \"\\q\"" ||
+        surrogate.getError().empty()) {
+        std::cerr << "String escapes were not decoded." << std::endl;
+        return 1;
+    }
+    const char* badEmits[] = {"Not a bare key: true", "A value without a key",
+                              "Table t inside a value",
+                              "endArray() without beginArray()",
+                              "Not a bare key: a b"};
+    Emitter bad[5];
+    bad[0].key("true");
+    bad[1].integer(1);
+    bad[2].key("a").beginArray().table("t");
+    bad[3].key("a").integer(1).endArray();
+    bad[4].key("a b").integer(1).key("c");
+    for (int i = 0; i < 5; ++i) {
+        if (bad[i].getError() != badEmits[i]) {
+            std::cerr << "Emitter reported \"" << bad[i].getError()
+                      << "\" instead of \"" << badEmits[i] << "\"" << std::endl;
+            return 1;
+        }
+    }
+    std::FILE* emitFile = std::tmpfile();
+    {
+        Emitter toFile(fileno(emitFile));
+        parseEvents(Source::read("tests/test.toml"), toFile);
+        if (!toFile.flush() || !toFile.view().empty()) {
+            std::cerr << "Emitting to a descriptor failed." << std::endl;
+            return 1;
+        }
+    }
+    std::string written(4096, '\0');
+    std::rewind(emitFile);
+    written.resize(std::fread(&written[0], 1, written.size(), emitFile));
+    std::fclose(emitFile);
+    emitter.clear();
+    if (written != std::string(emitter.document(toml.getDocument()).view())) {
+        std::cerr << "Events re-emitted differently:\n" << written << std::endl;
+        return 1;
+    }
+
+    // The grammar reports every table, key and value to a Handler, and a
+    // handler can stop the parse; syntax errors are the Parser's.
+    EventLog events;
+    std::string eventError;
+    const char* eventText = "t = \"x\"\n[s]\np = [1, [2]]\nq = 3\n";
+    if (!parseEvents(Source::borrow(eventText), events, &eventError) ||
+        events.log != "t=x [s p=( 1 ( 2 ) ) q=3 ] ") {
+        std::cerr << "Unexpected events: " << events.log << std::endl;
+        return 1;
+    }
+    EventLog stopped;
+    stopped.stop = "p";
+    if (parseEvents(Source::borrow(eventText), stopped, &eventError) ||
+        !eventError.empty() || stopped.log != "t=x [s p=" ||
+        parseEvents(Source::borrow("[s]\np = [1\n"), events, &eventError) ||
+        eventError != "Unexpected token: EOF") {
+        std::cerr << "Stopping or failing a parse of events went wrong: "
+                  << stopped.log << eventError << std::endl;
+        return 1;
+    }
+
+    // Binding fills the structs straight from the parse and reports the
+    // first missing or mistyped field by its dotted path.
+    Project project;
+    std::string bindError;
+    if (!bind(Source::read("tests/test.toml"), project, &bindError) ||
+        project.package.name != "gtoml" || project.package.version != 0.1 ||
+        !project.package.is_experimental ||
+        project.package.files.size() != 5 ||
+        project.package.files[4] != "src/libgtoml.hpp" ||
+        project.package.downloads || project.tls.port != 443) {
+        std::cerr << "Binding test.toml failed: " << bindError << std::endl;
+        return 1;
+    }
+    const char* nested =
+        "grid = [[1, 2], [3]]\n[package]\nname = \"n\"\nversion = 2\n"
+        "is_experimental = false\nfiles = []\nunknown = [1, [\"x\"]]\n"
+        "downloads = 7\ndownloads = 8\n[other]\nport = \"x\"\n"
+        "[tls]\ncert = \"c.pem\"\nport = 8443\n";
+    if (!bind(Source::borrow(nested), project, &bindError) ||
+        project.grid.size() != 2 || project.grid[0][1] != 2 ||
+        project.package.version != 2.0 || !project.package.files.empty() ||
+        project.package.downloads != 7 || project.tls.cert != "c.pem" ||
+        project.tls.port != 8443) {
+        std::cerr << "Binding nested tables failed: " << bindError
+                  << std::endl;
+        return 1;
+    }
+    struct {
+        const char* text;
+        const char* error;
+    } badBindings[] = {
+        {"[package]\nname = 1\n",
+         "Expected string for package.name but got integer"},
+        {"[package]\nname = \"n\"\nversion = 1.0\nis_experimental = true\n",
+         "Missing key package.files"},
+        {"[tls]\ncert = \"c\"\n", "Missing table package"},
+        {"[package.name]\n", "Expected string for package.name but got table"},
+        {"[tls]\nport = 70000\n", "Integer out of range for tls.port: 70000"},
+        {"grid = [1]\n", "Expected array for grid but got integer"},
+        {"[package]\nfiles = [\"a\"\n", "Unexpected token: EOF"},
+    };
+    for (const auto& bad : badBindings) {
+        Project ignored;
+        if (bind(Source::borrow(bad.text), ignored, &bindError) ||
+            bindError != bad.error) {
+            std::cerr << "Binding reported \"" << bindError << "\" instead of \""
+                      << bad.error << "\"" << std::endl;
+            return 1;
+        }
+    }
+
+    BatchLoader loader(3);
+    auto files = loader.loadFiles(
+        {"tests/test.toml", "tests/missing.toml", "tests/test.toml",
+         "tests"});
+    auto mapped = loader.loadFiles({"tests", "tests/test.toml"}, Input::Map);
+    auto buffers = loader.loadBuffers(
+        {"a = 1\n", "[broken\n", "[t]\nb = true\n", "c = 2.5\n"});
+    if (files.size() != 4 || !files[0].ok() || files[1].ok() ||
+        !files[2].ok() || files[3].ok() ||
+        files[3].error != "File tests cannot be read" || mapped[0].ok() ||
+        !mapped[1].ok() || Source::read("tests") || Source::map("tests") ||
+        files[2].document.get<double>("package.version") != 0.1 ||
+        buffers.size() != 4 || !buffers[0].ok() || buffers[1].ok() ||
+        buffers[1].error.empty() ||
+        buffers[0].document.get<int64_t>("a") != 1 ||
+        buffers[2].document.get<bool>("t.b") != true ||
+        buffers[3].document.get<double>("c") != 2.5) {
+        std::cerr << "Batch loading returned wrong results." << std::endl;
+        return 1;
+    }
+
+    // The first load parses and writes the cache, the second maps it.
+    std::remove("tests/test.snapshot");
+    auto built = Snapshot::load("tests/test.toml", "tests/test.snapshot");
+    auto cached = Snapshot::open("tests/test.snapshot");
+    auto reloaded = Snapshot::load("tests/test.toml", "tests/test.snapshot",
+                                   Validate::Mtime);
+    if (!built || !cached || !reloaded ||
+        !cached->isFreshFor(Source::read("tests/test.toml")->view()) ||
+        cached->isFreshFor("[package]\n") ||
+        cached->get<std::string_view>("package.name") != "gtoml" ||
+        cached->get<double>("package.version") != 0.1 ||
+        cached->get<bool>("package.is_experimental") != true ||
+        cached->find("package.files").size() != 5 ||
+        cached->find("package.files")[4].asString() != "src/libgtoml.hpp" ||
+        cached->root().size() != 1 || cached->root().key(0) != "package" ||
+        cached->root().value(0).size() != 4 ||
+        reloaded->get<std::string_view>("package.name") != "gtoml" ||
+        cached->find("package.missing").kind() != Kind::None ||
+        Snapshot::open(Source::copy("GTOMLSNP but not a snapshot"))) {
+        std::cerr << "Snapshot does not match the parsed document."
+                  << std::endl;
+        return 1;
+    }
+    std::remove("tests/test.snapshot");
+
+    // A rewrite of the same size within the same second is seen by
+    // Validate::Mtime, and concurrent writers each leave a whole snapshot.
+    std::ofstream("tests/mtime.toml") << "v = 1\n";
+    auto older = Snapshot::load("tests/mtime.toml", "tests/mtime.snapshot",
+                                Validate::Mtime);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::ofstream("tests/mtime.toml") << "v = 2\n";
+    auto newer = Snapshot::load("tests/mtime.toml", "tests/mtime.snapshot",
+                                Validate::Mtime);
+    Parser raced(Source::borrow("v = 3\n"));
+    std::atomic<int> failedWrites{0};
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 8; ++t) {
+        writers.emplace_back([&] {
+            for (int i = 0; i < 20; ++i) {
+                failedWrites += !Snapshot::write(raced.getDocument(),
+                                                 "v = 3\n", 0,
+                                                 "tests/mtime.snapshot");
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    auto raceWinner = Snapshot::open("tests/mtime.snapshot");
+    if (!older || older->get<int64_t>("v") != 1 || !newer ||
+        newer->get<int64_t>("v") != 2 || failedWrites != 0 || !raceWinner ||
+        raceWinner->get<int64_t>("v") != 3) {
+        std::cerr << "Snapshot cache missed a rewrite or a concurrent write."
+                  << std::endl;
+        return 1;
+    }
+    std::remove("tests/mtime.toml");
+    std::remove("tests/mtime.snapshot");
+
+    // Saving a new version is picked up by the watcher; a broken one is not
+    // published.
+    std::ofstream("tests/reload.toml") << "[server]\nport = 1\n";
+    {
+        ReloadableDocument live("tests/reload.toml");
+        auto waitFor = [&](uint64_t version, bool failed) {
+            for (int i = 0; i < 200; ++i) {
+                if (live.version() >= version &&
+                    live.lastError().empty() != failed) {
+                    return true;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return false;
+        };
+        bool first = live.read()->get<int64_t>("server.port") == 1;
+        std::ofstream("tests/reload.tmp") << "[server]\nport = 2\n";
+        std::rename("tests/reload.tmp", "tests/reload.toml");
+        bool renamed = waitFor(2, false) &&
+                       live.read()->get<int64_t>("server.port") == 2;
+        std::ofstream("tests/reload.toml") << "[server\nport = 3\n";
+        bool kept = waitFor(2, true) &&
+                    live.read()->get<int64_t>("server.port") == 2;
+        if (!first || !renamed || !kept) {
+            std::cerr << "Reloading did not follow the file." << std::endl;
+            return 1;
+        }
+    }
+    std::remove("tests/reload.toml");
+
+    Parser missing("tests/missing.toml");
+    if (missing.Parse()) {
+        std::cerr << "Parsed a file that does not exist." << std::endl;
+    }
+
     return 0;
 }